@@ -0,0 +1,37 @@
+//Binary log throughput into a large in-memory ring with different page placements.
+//Build: g++ -std=c++17 -O2 bench_ring.cpp -o bench_ring
+//Compare TLB misses with: perf stat -e dTLB-load-misses,dTLB-store-misses ./bench_ring none|transparent|reserved
+
+#include "constexpr_binlog_ring.hpp"
+
+#include <cstring>
+
+int main(int argc, char** argv) {
+    using namespace constexpr_format;
+    memory::Placement placement;
+    const char* mode = argc > 1 ? argv[1] : "transparent";
+    if(std::strcmp(mode,"none") == 0) {
+        placement = {memory::HugePages::none,false};
+    } else if(std::strcmp(mode,"reserved") == 0) {
+        placement.huge_pages = memory::HugePages::reserved;
+    }
+
+    constexpr std::size_t capacity = std::size_t(1) << 30;
+    constexpr int messages = 50000000;
+    binlog::LocalRing ring(capacity,64*1024,placement);
+    if(!ring) {
+        std::fprintf(stderr,"allocation failed\n");
+        return 1;
+    }
+    binlog::Writer writer(ring);
+
+    const auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < messages; ++i) {
+        CONSTEXPR_FORMAT_BINLOG(writer, "request %d took %d us on %s", i, i % 977, "worker");
+    }
+    const auto ns = std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-start).count();
+
+    const auto& applied = ring.applied();
+    std::printf("%-12s %6.2f ns/message  reserved huge pages: %d  transparent huge pages: %d  node: %d\n",
+        mode,ns/messages,applied.reserved_huge_pages,applied.transparent_huge_pages,applied.node);
+}
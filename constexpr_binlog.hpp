@@ -0,0 +1,611 @@
+#pragma once
+
+#include "constexpr_format.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace constexpr_format {
+
+    namespace binlog {
+        //Nanoseconds since the Unix epoch, formatted by %T as YYYY-MM-DD HH:MM:SS.nnnnnnnnn (UTC)
+        struct WallClock {
+            std::int64_t ns;
+        };
+    }
+
+    template<>
+    struct Format<binlog::WallClock> {
+        constexpr static std::size_t length = 29;
+
+        //Days since 1970-01-01 to year/month/day, see http://howardhinnant.github.io/date_algorithms.html#civil_from_days
+        static void civil_from_days(std::int64_t z, std::int64_t& y, unsigned& m, unsigned& d) {
+            z += 719468;
+            const std::int64_t era = (z >= 0 ? z : z-146096)/146097;
+            const unsigned doe = static_cast<unsigned>(z-era*146097);
+            const unsigned yoe = (doe-doe/1460+doe/36524-doe/146096)/365;
+            const unsigned doy = doe-(365*yoe+yoe/4-yoe/100);
+            const unsigned mp = (5*doy+2)/153;
+            d = doy-(153*mp+2)/5+1;
+            m = mp < 10 ? mp+3 : mp-9;
+            y = static_cast<std::int64_t>(yoe)+era*400+(m <= 2);
+        }
+
+        static std::size_t size(const binlog::WallClock&) {
+            return length;
+        }
+
+        static char* write(char* out, const binlog::WallClock& t, std::size_t len) {
+            char buffer[length];
+            const std::int64_t seconds = t.ns >= 0 ? t.ns/1000000000 : (t.ns-999999999)/1000000000;
+            const std::int64_t days = seconds >= 0 ? seconds/86400 : (seconds-86399)/86400;
+            const std::int64_t second_of_day = seconds-days*86400;
+            std::int64_t y;
+            unsigned m, d;
+            civil_from_days(days,y,m,d);
+
+            char* p = buffer;
+            p = util::write_digits(p,static_cast<std::uint32_t>(y),4);
+            *p++ = '-';
+            p = util::write_digits(p,m,2);
+            *p++ = '-';
+            p = util::write_digits(p,d,2);
+            *p++ = ' ';
+            p = util::write_digits(p,static_cast<std::uint32_t>(second_of_day/3600),2);
+            *p++ = ':';
+            p = util::write_digits(p,static_cast<std::uint32_t>(second_of_day/60%60),2);
+            *p++ = ':';
+            p = util::write_digits(p,static_cast<std::uint32_t>(second_of_day%60),2);
+            *p++ = '.';
+            util::write_digits(p,static_cast<std::uint32_t>(t.ns-seconds*1000000000),9);
+
+            std::memcpy(out,buffer,len);
+            return out+len;
+        }
+    };
+
+    namespace format_to_typecheck {
+        auto to_type(CharV<'T'>) -> Id<binlog::WallClock>;
+    }
+
+}
+
+//Binary logging: messages are stored as a site id, a timestamp and the raw arguments, formatting happens when decoding.
+//The stream is in native byte order:
+//  header:      "CFBLOG\0\3", Calibration
+//  definition:  'D', u32 id, u32 line, u8 arg count, one type code per argument, u16 length + file, u16 length + format
+//  message:     'M' or 'A', u32 id, u64 ticks, arguments
+//Integers are stored as varints, zig-zag encoded if signed. Arguments wrapped in binlog::delta store the zig-zag
+//encoded difference to the same argument of the site's previous message in the stream instead. In 'A' messages
+//that difference is to 0, a site's first message and every absolute_interval-th one after are 'A', so a stream
+//that lost older records, like a ring buffer, is decodable again from the next 'A' message of each site on.
+//Strings are stored as a varint length followed by the bytes.
+//Argument types are fixed per site, so messages carry no type tags.
+//A site's definition is written before its first message in every stream, so streams decode on their own.
+namespace constexpr_format::binlog {
+
+    //Raw timestamp counter, the TSC where available, steady_clock nanoseconds otherwise
+    inline std::uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        std::uint64_t v;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+        return v;
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    //Relates ticks to wall-clock time, stored in the stream header for the decoder
+    struct Calibration {
+        double ticks_per_second;
+        std::uint64_t ref_ticks;
+        std::int64_t ref_unix_ns;
+
+        std::int64_t to_unix_ns(std::uint64_t t) const {
+            const double delta = static_cast<double>(static_cast<std::int64_t>(t-ref_ticks));
+            return ref_unix_ns + static_cast<std::int64_t>(delta*1e9/ticks_per_second);
+        }
+    };
+
+    //Measures the tick rate against steady_clock over the given interval
+    inline Calibration calibrate(std::chrono::milliseconds interval = std::chrono::milliseconds(20)) {
+        using namespace std::chrono;
+        const auto s0 = steady_clock::now();
+        const auto t0 = ticks();
+        std::this_thread::sleep_for(interval);
+        const auto s1 = steady_clock::now();
+        const auto t1 = ticks();
+
+        Calibration c;
+        c.ticks_per_second = static_cast<double>(t1-t0)/duration<double>(s1-s0).count();
+        c.ref_ticks = ticks();
+        c.ref_unix_ns = duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+        return c;
+    }
+
+    //Calibration shared by all writers of the process, measured on first use
+    inline const Calibration& process_calibration() {
+        static const Calibration c = calibrate();
+        return c;
+    }
+
+    //Marks an integer argument for delta encoding against the site's previous value, for counters and ids that change slowly
+    template<typename T>
+    struct Delta {
+        T value;
+    };
+
+    template<typename T>
+    constexpr Delta<T> delta(T value) {
+        static_assert(std::is_integral_v<T>, "Only integers can be delta encoded");
+        return {value};
+    }
+
+    namespace detail {
+        constexpr char header_magic[8] = {'C','F','B','L','O','G','\0','\3'};
+
+        //Messages of a site with delta arguments between two 'A' messages
+        constexpr std::uint32_t absolute_interval = 64;
+
+        constexpr bool is_delta_code(char type) {return type == 'I' || type == 'U';}
+
+        //Longest varint of a 64 bit value
+        constexpr std::size_t max_varint_size = 10;
+
+        template<typename T>
+        struct argument {
+            using type = T;
+            static const T& value(const T& v) {return v;}
+        };
+
+        template<typename T>
+        struct argument<Delta<T>> {
+            using type = T;
+            static const T& value(const Delta<T>& v) {return v.value;}
+        };
+
+        //Range hints only matter for text formatting, the value is stored as a plain integer
+        template<typename T, T Min, T Max>
+        struct argument<Ranged<T,Min,Max>> {
+            using type = T;
+            static const T& value(const Ranged<T,Min,Max>& v) {return v.value;}
+        };
+
+        //Type the format sees for an argument
+        template<typename T>
+        using argument_t = typename argument<T>::type;
+
+        template<typename T>
+        struct is_delta : std::false_type {};
+
+        template<typename T>
+        struct is_delta<Delta<T>> : std::true_type {};
+
+        template<typename T>
+        constexpr char type_code() {
+            using V = argument_t<T>;
+            if constexpr(std::is_integral_v<V> && std::is_signed_v<V>) {
+                return is_delta<T>::value ? 'I' : 'i';
+            } else if constexpr(std::is_integral_v<V>) {
+                return is_delta<T>::value ? 'U' : 'u';
+            } else {
+                static_assert(util::is_string_like<V>::value, "Binary logging supports integer and string arguments");
+                return 's';
+            }
+        }
+
+        //Upper bound, the record is committed with its actual size
+        template<typename T>
+        std::size_t max_encoded_size(const T& v) {
+            if constexpr(std::is_integral_v<argument_t<T>>) {
+                return max_varint_size;
+            } else {
+                return max_varint_size+util::to_view(v).size();
+            }
+        }
+
+        constexpr std::uint64_t zigzag(std::int64_t v) {
+            return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+        }
+
+        constexpr std::int64_t unzigzag(std::uint64_t v) {
+            return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+        }
+
+        inline void put_varint(char*& out, std::uint64_t v) {
+            while(v >= 0x80) {
+                *out++ = static_cast<char>(v | 0x80);
+                v >>= 7;
+            }
+            *out++ = static_cast<char>(v);
+        }
+
+        inline bool get_varint(const char*& in, const char* end, std::uint64_t& v) {
+            v = 0;
+            for(unsigned shift = 0; in < end && shift < 64; shift += 7) {
+                const auto byte = static_cast<unsigned char>(*in++);
+                v |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+                if(byte < 0x80) return true;
+            }
+            return false;
+        }
+
+        template<typename T>
+        void put(char*& out, T v) {
+            std::memcpy(out,&v,sizeof(T));
+            out += sizeof(T);
+        }
+
+        template<typename T>
+        T get(const char*& in) {
+            T v;
+            std::memcpy(&v,in,sizeof(T));
+            in += sizeof(T);
+            return v;
+        }
+
+        //previous is the argument's slot in the site's delta state
+        template<typename T>
+        void encode(char*& out, const T& arg, std::uint64_t& previous) {
+            using V = argument_t<T>;
+            const V& v = argument<T>::value(arg);
+            if constexpr(is_delta<T>::value) {
+                const auto current = static_cast<std::uint64_t>(v);
+                put_varint(out,zigzag(static_cast<std::int64_t>(current-previous)));
+                previous = current;
+            } else if constexpr(std::is_integral_v<V> && std::is_signed_v<V>) {
+                put_varint(out,zigzag(v));
+            } else if constexpr(std::is_integral_v<V>) {
+                put_varint(out,v);
+            } else {
+                const auto s = util::to_view(v);
+                put_varint(out,s.size());
+                out = util::copy(out,s);
+            }
+        }
+
+        inline std::atomic<std::uint32_t> next_site_id{1};
+
+        //Site ids are handed out in order, so a stream only skips the ids of sites it has no messages of.
+        //Readers reject ids further ahead than this instead of allocating for any id a corrupt stream names.
+        constexpr std::uint32_t max_id_gap = 1u << 16;
+
+        inline bool plausible_id(std::uint32_t id, std::size_t known) {
+            return id < known+max_id_gap;
+        }
+
+        //Outputs can keep the stream header and site definitions apart from messages by providing
+        //reserve_meta/commit_meta, e.g. so a ring buffer doesn't overwrite them
+        template<typename Output, typename SFINAE_Check=void>
+        struct has_meta : std::false_type {};
+
+        template<typename Output>
+        struct has_meta<Output,std::void_t<decltype(std::declval<Output&>().reserve_meta(std::size_t{}))>> : std::true_type {};
+
+        template<typename Output>
+        char* reserve_meta(Output& out, std::size_t n) {
+            if constexpr(has_meta<Output>::value) {
+                return out.reserve_meta(n);
+            } else {
+                return out.reserve(n);
+            }
+        }
+
+        template<typename Output>
+        void commit_meta(Output& out, std::size_t n) {
+            if constexpr(has_meta<Output>::value) {
+                out.commit_meta(n);
+            } else {
+                out.commit(n);
+            }
+        }
+    }
+
+    //Per call site id, assigned on first use
+    template<typename StringOrFormatF>
+    inline std::atomic<std::uint32_t> site_id{0};
+
+    template<typename StringOrFormatF>
+    std::uint32_t get_site_id() {
+        auto& id = site_id<StringOrFormatF>;
+        auto current = id.load(std::memory_order_relaxed);
+        if(current == 0) {
+            const auto fresh = detail::next_site_id.fetch_add(1,std::memory_order_relaxed);
+            current = id.compare_exchange_strong(current,fresh,std::memory_order_relaxed) ? fresh : current;
+        }
+        return current;
+    }
+
+    //Output backed by memory, any type with char* reserve(std::size_t) and commit(std::size_t) can be written to
+    class MemoryOutput {
+        std::vector<char> buffer;
+        std::size_t used = 0;
+    public:
+        char* reserve(std::size_t n) {
+            if(buffer.size() < used+n) buffer.resize(std::max(buffer.size()*2,used+n));
+            return buffer.data()+used;
+        }
+        void commit(std::size_t n) {
+            used += n;
+        }
+
+        const char* data() const {return buffer.data();}
+        std::size_t size() const {return used;}
+    };
+
+    //Writes records to an output, not thread-safe
+    template<typename Output>
+    class Writer {
+        Output& out;
+        std::vector<bool> defined;
+        //Previous value of every argument of every site, used for delta encoding
+        std::vector<std::vector<std::uint64_t>> previous;
+        //Messages left until a site's next 'A' message
+        std::vector<std::uint32_t> until_absolute;
+
+        template<typename StringOrFormatF, typename... Args>
+        void define(std::uint32_t id, const char* file, int line, StringOrFormatF format) {
+            util::string_view fmt{"",0};
+            if constexpr(std::is_convertible_v<decltype(format()),util::string_view>) {
+                fmt = format();
+            }
+            const util::string_view f = util::to_view(file ? file : "?");
+            const std::size_t n = 1+4+4+1+sizeof...(Args)+2+f.size()+2+fmt.size();
+
+            char* p = detail::reserve_meta(out,n);
+            *p++ = 'D';
+            detail::put(p,id);
+            detail::put(p,static_cast<std::uint32_t>(line));
+            detail::put(p,static_cast<std::uint8_t>(sizeof...(Args)));
+            ((*p++ = detail::type_code<Args>()), ...);
+            detail::put(p,static_cast<std::uint16_t>(f.size()));
+            p = util::copy(p,f);
+            detail::put(p,static_cast<std::uint16_t>(fmt.size()));
+            util::copy(p,fmt);
+            detail::commit_meta(out,n);
+
+            if(defined.size() <= id) {
+                defined.resize(id+1);
+                previous.resize(id+1);
+                until_absolute.resize(id+1);
+            }
+            defined[id] = true;
+            previous[id].assign(sizeof...(Args),0);
+            until_absolute[id] = 0;
+        }
+
+        template<typename... Args, std::size_t... I>
+        void encode_args(char*& p, std::uint64_t* prev, std::index_sequence<I...>, const Args&... args) {
+            (detail::encode<std::decay_t<const Args&>>(p,args,prev[I]), ...);
+        }
+    public:
+        explicit Writer(Output& out, const Calibration& calibration = process_calibration()) : out(out) {
+            const std::size_t n = sizeof(detail::header_magic)+sizeof(Calibration);
+            char* p = detail::reserve_meta(out,n);
+            std::memcpy(p,detail::header_magic,sizeof(detail::header_magic));
+            std::memcpy(p+sizeof(detail::header_magic),&calibration,sizeof(Calibration));
+            detail::commit_meta(out,n);
+        }
+
+        template<typename StringOrFormatF, typename... Args>
+        void write_at(const char* file, int line, StringOrFormatF format, const Args&... args) {
+            constexpr auto f = format_runtime::detail::get_format(format);
+            static_assert(format_string::detail::check_format<std::tuple<detail::argument_t<std::decay_t<const Args&>>...>>(f));
+
+            const auto t = ticks();
+            const auto id = get_site_id<StringOrFormatF>();
+            if(id >= defined.size() || !defined[id]) {
+                define<StringOrFormatF,std::decay_t<const Args&>...>(id,file,line,format);
+            }
+
+            char kind = 'M';
+            if constexpr((detail::is_delta_code(detail::type_code<std::decay_t<const Args&>>()) || ... || false)) {
+                if(until_absolute[id] == 0) {
+                    kind = 'A';
+                    std::fill(previous[id].begin(),previous[id].end(),0);
+                    until_absolute[id] = detail::absolute_interval;
+                }
+                --until_absolute[id];
+            }
+
+            const std::size_t max_size = 1+4+8+(detail::max_encoded_size<std::decay_t<const Args&>>(args) + ... + 0);
+            char* const start = out.reserve(max_size);
+            char* p = start;
+            *p++ = kind;
+            detail::put(p,id);
+            detail::put(p,t);
+            encode_args(p,previous[id].data(),std::index_sequence_for<Args...>{},args...);
+            out.commit(p-start);
+        }
+
+        template<typename StringOrFormatF, typename... Args>
+        void write(StringOrFormatF format, const Args&... args) {
+            write_at(nullptr,0,format,args...);
+        }
+    };
+
+    namespace detail {
+
+        struct Value {
+            char type;
+            std::int64_t i;
+            std::uint64_t u;
+            util::string_view s{"",0};
+
+            long long as_int() const {return type == 'i' ? i : static_cast<long long>(u);}
+        };
+
+        template<typename U>
+        void interpret_int(std::string& out, U magnitude, bool negative, const format_parser::FormatOptions& o) {
+            const auto l = format_parser::layout(util::count_digits(magnitude),true,negative,o);
+            const auto start = out.size();
+            out.resize(start+l.total());
+            char* p = out.data()+start;
+            p = format_runtime::detail::fill(p,' ',l.left);
+            if(l.sign != '\0') *p++ = l.sign;
+            p = format_runtime::detail::fill(p,'0',l.zeros);
+            p = util::write_digits(p,magnitude,l.body);
+            format_runtime::detail::fill(p,' ',l.right);
+        }
+
+        //Formats a format string against decoded values at runtime, supporting the %d and %s specifiers
+        inline void interpret(std::string& out, util::string_view fmt, const std::vector<Value>& values) {
+            std::size_t next = 0;
+            auto take = [&]() -> const Value& {
+                static const Value missing{'s',0,0};
+                return next < values.size() ? values[next++] : missing;
+            };
+            while(fmt.size() > 0) {
+                const auto pos = fmt.find('%');
+                out.append(fmt.begin(),pos);
+                fmt = fmt.remove_prefix(pos);
+                if(fmt.size() == 0) break;
+                if(fmt.size() > 1 && fmt[1] == '%') {
+                    out.push_back('%');
+                    fmt = fmt.remove_prefix(2);
+                    continue;
+                }
+
+                const auto parsed = format_parser::parse_printf_options(fmt);
+                const long long width = parsed.opts.dynamic_width ? take().as_int() : 0;
+                const long long precision = parsed.opts.dynamic_precision ? take().as_int() : 0;
+                const auto o = format_parser::resolve_dynamic(parsed.opts,width,precision);
+                const Value& v = take();
+                if(v.type == 'i') {
+                    interpret_int(out,v.i < 0 ? 0-static_cast<std::uint64_t>(v.i) : static_cast<std::uint64_t>(v.i),v.i < 0,o);
+                } else if(v.type == 'u') {
+                    interpret_int(out,v.u,false,o);
+                } else {
+                    const auto l = format_parser::layout(v.s.size(),false,false,o);
+                    out.append(l.left,' ');
+                    out.append(v.s.begin(),l.body);
+                    out.append(l.right,' ');
+                }
+                fmt = fmt.remove_prefix(parsed.spec_index+1);
+            }
+        }
+
+        struct Definition {
+            std::string types;
+            std::vector<std::uint64_t> previous;
+            //Whether previous holds the values of the site's last message, which takes an 'A' message in this stream
+            bool synced = false;
+            util::string_view file{"",0};
+            std::uint32_t line = 0;
+            util::string_view format{"",0};
+        };
+    }
+
+    //Decodes a whole stream, calling f(WallClock, util::string_view file, int line, const std::string& message) per message.
+    //Delta arguments of a site are printed as '?' until its first 'A' message, which only happens if older records were lost.
+    //Returns false if the stream is malformed or truncated, or defines a site id far beyond the ones before it.
+    template<typename F>
+    bool decode(const char* data, std::size_t size, F f) {
+        const char* in = data;
+        const char* end = data+size;
+        if(size < sizeof(detail::header_magic)+sizeof(Calibration) || std::memcmp(in,detail::header_magic,sizeof(detail::header_magic)) != 0) {
+            return false;
+        }
+        in += sizeof(detail::header_magic);
+        const auto calibration = detail::get<Calibration>(in);
+
+        std::vector<detail::Definition> definitions;
+        std::vector<detail::Value> values;
+        std::string message;
+        auto available = [&](std::size_t n) {return static_cast<std::size_t>(end-in) >= n;};
+        auto get_view = [&](std::size_t n) {
+            util::string_view v(in,n);
+            in += n;
+            return v;
+        };
+
+        while(in < end) {
+            const char kind = *in++;
+            if(kind == 'D') {
+                if(!available(9)) return false;
+                const auto id = detail::get<std::uint32_t>(in);
+                detail::Definition d;
+                d.line = detail::get<std::uint32_t>(in);
+                const auto nargs = detail::get<std::uint8_t>(in);
+                if(!available(nargs+2)) return false;
+                d.types.assign(in,nargs);
+                d.previous.assign(nargs,0);
+                in += nargs;
+                const auto file_size = detail::get<std::uint16_t>(in);
+                if(!available(file_size+2)) return false;
+                d.file = get_view(file_size);
+                const auto format_size = detail::get<std::uint16_t>(in);
+                if(!available(format_size)) return false;
+                d.format = get_view(format_size);
+                if(!detail::plausible_id(id,definitions.size())) return false;
+                if(definitions.size() <= id) definitions.resize(id+1);
+                definitions[id] = std::move(d);
+            } else if(kind == 'M' || kind == 'A') {
+                if(!available(12)) return false;
+                const auto id = detail::get<std::uint32_t>(in);
+                const auto t = detail::get<std::uint64_t>(in);
+                if(id >= definitions.size()) return false;
+                auto& d = definitions[id];
+                if(kind == 'A') {
+                    std::fill(d.previous.begin(),d.previous.end(),0);
+                    d.synced = true;
+                }
+
+                values.clear();
+                for(std::size_t i = 0; i < d.types.size(); ++i) {
+                    const char type = d.types[i];
+                    detail::Value v{type,0,0};
+                    std::uint64_t raw;
+                    if(!detail::get_varint(in,end,raw)) return false;
+                    if(type == 's') {
+                        if(!available(raw)) return false;
+                        v.s = get_view(raw);
+                    } else {
+                        if(detail::is_delta_code(type) && !d.synced) {
+                            v.type = 's';
+                            v.s = "?";
+                        } else if(detail::is_delta_code(type)) {
+                            d.previous[i] += static_cast<std::uint64_t>(detail::unzigzag(raw));
+                            raw = d.previous[i];
+                            v.type = type == 'I' ? 'i' : 'u';
+                        } else if(type == 'i') {
+                            raw = static_cast<std::uint64_t>(detail::unzigzag(raw));
+                        }
+                        v.u = raw;
+                        v.i = static_cast<std::int64_t>(raw);
+                    }
+                    values.push_back(v);
+                }
+                message.clear();
+                detail::interpret(message,d.format,values);
+                f(WallClock{calibration.to_unix_ns(t)},d.file,static_cast<int>(d.line),message);
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //One "timestamp message" line per record
+    inline std::string decode_to_text(const char* data, std::size_t size) {
+        std::string text;
+        decode(data,size,[&](WallClock time, util::string_view, int, const std::string& message) {
+            lazy_format([]{return util::string_view("%T %s\n");},time,message).append_to(text);
+        });
+        return text;
+    }
+
+}
+
+//Writes a binary record to writer, tagged with this call site's file and line
+#define CONSTEXPR_FORMAT_BINLOG(writer, format, ...) \
+    (writer).write_at(__FILE__, __LINE__, []{return ::constexpr_format::util::string_view(format);}, ##__VA_ARGS__)
@@ -0,0 +1,296 @@
+#pragma once
+
+#include "constexpr_binlog.hpp"
+#include "constexpr_memory.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//Ring buffer output for binary logs in a file-backed shared mapping, so the last records survive a crash of the writing process.
+//Memory layout:
+//  RingHeader
+//  meta area:  stream header and site definitions, append-only so they are never overwritten
+//  data area:  messages as u32 length + payload, padded to 8 bytes. A length of wrap_marker means the rest of the area is unused.
+//Writing is plain stores into the mapping, the kernel writes the pages back to the file.
+namespace constexpr_format::binlog {
+
+    struct alignas(64) RingHeader {
+        char magic[8];
+        std::uint64_t capacity;
+        std::uint64_t meta_capacity;
+        std::atomic<std::uint64_t> meta_size;
+        //Monotonic byte positions in the data area, everything in [tail,head) is a complete record
+        std::atomic<std::uint64_t> head;
+        std::atomic<std::uint64_t> tail;
+        //Set when a definition didn't fit in the meta area, messages of that site can't be decoded
+        std::atomic<std::uint32_t> meta_overflow;
+        //Records discarded because they are larger than the data area
+        std::atomic<std::uint64_t> oversized;
+    };
+
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "Ring positions must be lock-free to live in shared memory");
+
+    //Ring over externally owned memory, single writer
+    class Ring {
+        RingHeader* header = nullptr;
+        char* meta = nullptr;
+        char* data = nullptr;
+        std::uint64_t pending = 0;
+        bool discard = false;
+        std::vector<char> scratch;
+
+        constexpr static char magic[8] = {'C','F','R','I','N','G','\0','\2'};
+        constexpr static std::uint32_t wrap_marker = 0xFFFFFFFF;
+
+        constexpr static std::uint64_t round8(std::uint64_t n) {return (n+7) & ~std::uint64_t(7);}
+        constexpr static std::uint64_t record_size(std::uint64_t n) {return round8(4+n);}
+
+        std::uint32_t length_at(std::uint64_t pos) const {
+            std::uint32_t len;
+            std::memcpy(&len,data+pos%header->capacity,4);
+            return len;
+        }
+
+        //Drops the oldest records until [h,h+n) is free
+        void make_room(std::uint64_t h, std::uint64_t n) {
+            const auto capacity = header->capacity;
+            auto t = header->tail.load(std::memory_order_relaxed);
+            const auto start = t;
+            while(h+n-t > capacity) {
+                const auto len = length_at(t);
+                t += len == wrap_marker ? capacity-t%capacity : record_size(len);
+            }
+            if(t != start) header->tail.store(t,std::memory_order_release);
+        }
+
+        Ring(void* memory) :
+            header(static_cast<RingHeader*>(memory)),
+            meta(static_cast<char*>(memory)+sizeof(RingHeader)),
+            data(meta+round8(header->meta_capacity)) {}
+    public:
+        Ring() = default;
+
+        static std::size_t required_size(std::size_t capacity, std::size_t meta_capacity) {
+            return sizeof(RingHeader)+round8(meta_capacity)+round8(capacity);
+        }
+
+        //Initializes required_size(capacity,meta_capacity) bytes of zeroed memory as an empty ring
+        static Ring create(void* memory, std::size_t capacity, std::size_t meta_capacity) {
+            auto* h = static_cast<RingHeader*>(memory);
+            h->capacity = round8(capacity);
+            h->meta_capacity = round8(meta_capacity);
+            h->meta_size.store(0,std::memory_order_relaxed);
+            h->head.store(0,std::memory_order_relaxed);
+            h->tail.store(0,std::memory_order_relaxed);
+            h->meta_overflow.store(0,std::memory_order_relaxed);
+            h->oversized.store(0,std::memory_order_relaxed);
+            std::memcpy(h->magic,magic,sizeof(magic));
+            return Ring(memory);
+        }
+
+        //Ring previously set up by create, e.g. in a file left behind by a crashed process. Invalid if the magic doesn't match.
+        static Ring attach(void* memory, std::size_t size) {
+            if(size < sizeof(RingHeader) || std::memcmp(static_cast<RingHeader*>(memory)->magic,magic,sizeof(magic)) != 0) {
+                return Ring();
+            }
+            Ring r(memory);
+            const auto* h = r.header;
+            if(h->capacity == 0 || h->capacity > size || h->meta_capacity > size ||
+                size < required_size(h->capacity,h->meta_capacity)) return Ring();
+            return r;
+        }
+
+        explicit operator bool() const {return header != nullptr;}
+
+        const RingHeader& state() const {return *header;}
+
+        //Output interface. A record larger than the capacity goes to scratch memory instead and is counted as oversized on commit,
+        //making room for it would drop everything and still overrun the data area.
+        char* reserve(std::size_t n) {
+            const auto capacity = header->capacity;
+            const auto need = record_size(n);
+            discard = need > capacity;
+            if(discard) {
+                scratch.resize(n);
+                return scratch.data();
+            }
+            auto h = header->head.load(std::memory_order_relaxed);
+            const auto left = capacity-h%capacity;
+            if(left < need) {
+                make_room(h,left);
+                std::memcpy(data+h%capacity,&wrap_marker,4);
+                h += left;
+                header->head.store(h,std::memory_order_release);
+            }
+            make_room(h,need);
+            pending = h;
+            return data+h%capacity+4;
+        }
+
+        void commit(std::size_t n) {
+            if(discard) {
+                header->oversized.fetch_add(1,std::memory_order_relaxed);
+                return;
+            }
+            const auto len = static_cast<std::uint32_t>(n);
+            std::memcpy(data+pending%header->capacity,&len,4);
+            header->head.store(pending+record_size(n),std::memory_order_release);
+        }
+
+        char* reserve_meta(std::size_t n) {
+            const auto used = header->meta_size.load(std::memory_order_relaxed);
+            if(used+n > header->meta_capacity) {
+                header->meta_overflow.store(1,std::memory_order_relaxed);
+                scratch.resize(n);
+                return scratch.data();
+            }
+            return meta+used;
+        }
+
+        void commit_meta(std::size_t n) {
+            const auto used = header->meta_size.load(std::memory_order_relaxed);
+            if(used+n <= header->meta_capacity) {
+                header->meta_size.store(used+n,std::memory_order_release);
+            }
+        }
+
+        //Consumer side, safe against the writer running concurrently in another process.
+        //Calls f(const char* record, std::size_t n) for each complete record from cursor on, and advances cursor.
+        //Stops right after skipping bytes the writer overwrote before they could be read and returns their number,
+        //so the caller can handle the gap before reading on. Returns 0 once it caught up with the writer.
+        template<typename F>
+        std::uint64_t read(std::uint64_t& cursor, std::vector<char>& buffer, F f) const {
+            const auto capacity = header->capacity;
+            const auto h = header->head.load(std::memory_order_acquire);
+            std::uint64_t lost = 0;
+            while(cursor < h) {
+                const auto t = header->tail.load(std::memory_order_acquire);
+                if(cursor < t) {
+                    lost = t-cursor;
+                    cursor = t;
+                    break;
+                }
+                const auto len = length_at(cursor);
+                if(len == wrap_marker) {
+                    cursor += capacity-cursor%capacity;
+                    continue;
+                }
+                //Copy first, then check the record wasn't overwritten in the meantime
+                const bool fits = record_size(len) <= capacity-cursor%capacity;
+                if(fits) {
+                    buffer.resize(len);
+                    std::memcpy(buffer.data(),data+cursor%capacity+4,len);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(header->tail.load(std::memory_order_relaxed) > cursor) continue;
+                if(!fits) break;
+                f(static_cast<const char*>(buffer.data()),static_cast<std::size_t>(len));
+                cursor += record_size(len);
+            }
+            return lost;
+        }
+
+        //Empties the ring, e.g. before another writer takes it over
+        void clear() {
+            header->meta_size.store(0,std::memory_order_relaxed);
+            header->tail.store(0,std::memory_order_relaxed);
+            header->meta_overflow.store(0,std::memory_order_relaxed);
+            header->oversized.store(0,std::memory_order_relaxed);
+            header->head.store(0,std::memory_order_release);
+        }
+
+        //Bytes of the meta area committed so far
+        util::string_view meta_contents() const {
+            return {meta,static_cast<std::size_t>(header->meta_size.load(std::memory_order_acquire))};
+        }
+
+        //Stream of the ring's contents, oldest message first, ready for decode.
+        //The ring may come from a torn file, so it stops at the first record that doesn't fit the data area.
+        std::string linearize() const {
+            const auto capacity = header->capacity;
+            const auto meta_size = header->meta_size.load(std::memory_order_acquire);
+            std::string stream(meta,std::min<std::uint64_t>(meta_size,header->meta_capacity));
+            const auto h = header->head.load(std::memory_order_acquire);
+            auto t = header->tail.load(std::memory_order_acquire);
+            if(t > h || h-t > capacity) return stream;
+            while(t < h) {
+                const auto len = length_at(t);
+                if(len == wrap_marker) {
+                    t += capacity-t%capacity;
+                } else {
+                    if(record_size(len) > capacity-t%capacity) break;
+                    stream.append(data+t%capacity+4,len);
+                    t += record_size(len);
+                }
+            }
+            return stream;
+        }
+    };
+
+    //Ring in a file mapped with MAP_SHARED. Creating one truncates the file, recover it first to keep its records.
+    class MappedRing : public Ring {
+        void* mapping = MAP_FAILED;
+        std::size_t size = 0;
+    public:
+        MappedRing(const char* path, std::size_t capacity, std::size_t meta_capacity = 64*1024, memory::Placement placement = {}) {
+            const auto n = required_size(capacity,meta_capacity);
+            const int fd = ::open(path,O_RDWR|O_CREAT|O_TRUNC,0644);
+            if(fd < 0) return;
+            if(::ftruncate(fd,static_cast<off_t>(n)) == 0) {
+                mapping = ::mmap(nullptr,n,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+            }
+            ::close(fd);
+            if(mapping == MAP_FAILED) return;
+            size = n;
+            memory::place(mapping,n,placement);
+            static_cast<Ring&>(*this) = Ring::create(mapping,capacity,meta_capacity);
+        }
+
+        MappedRing(const MappedRing&) = delete;
+        MappedRing& operator=(const MappedRing&) = delete;
+
+        ~MappedRing() {
+            if(mapping != MAP_FAILED) ::munmap(mapping,size);
+        }
+
+        //Schedules write-back of the mapping, only needed to survive machine crashes as well
+        void sync() {
+            if(mapping != MAP_FAILED) ::msync(mapping,size,MS_ASYNC);
+        }
+    };
+
+    //Ring in anonymous memory of this process, e.g. to keep the latest records for a core dump or to drain them in-process
+    class LocalRing : public Ring {
+        memory::Region region;
+    public:
+        LocalRing(std::size_t capacity, std::size_t meta_capacity = 64*1024, memory::Placement placement = {}) :
+            region(required_size(capacity,meta_capacity),placement) {
+            if(region) static_cast<Ring&>(*this) = Ring::create(region.data(),capacity,meta_capacity);
+        }
+
+        const memory::Applied& applied() const {return region.applied();}
+    };
+
+    //Reads the ring left in path as a stream for decode, empty if the file isn't a ring
+    inline std::string recover(const char* path) {
+        const int fd = ::open(path,O_RDONLY);
+        if(fd < 0) return {};
+        struct stat st;
+        void* memory = MAP_FAILED;
+        if(::fstat(fd,&st) == 0 && st.st_size > 0) {
+            memory = ::mmap(nullptr,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+        }
+        ::close(fd);
+        if(memory == MAP_FAILED) return {};
+
+        std::string stream;
+        if(const auto ring = Ring::attach(memory,st.st_size)) {
+            stream = ring.linearize();
+        }
+        ::munmap(memory,st.st_size);
+        return stream;
+    }
+
+}
@@ -0,0 +1,375 @@
+#pragma once
+
+#include "constexpr_binlog_ring.hpp"
+
+#include <cerrno>
+#include <csignal>
+
+//Binary logs of several processes on one host, collected into a single stream.
+//A POSIX shared memory segment holds one Ring per process slot. Writer processes claim a free slot with ProcessRing
+//and log to it like to any other output, a collector process drains every slot, merges the messages by timestamp
+//and writes them as one stream in the regular binary format.
+//Segment layout:
+//  SegmentHeader
+//  SlotState per slot
+//  Ring per slot, ring_size bytes each
+//Ticks are compared across processes, so writers must share a host-wide clock (an invariant TSC or the steady_clock fallback).
+namespace constexpr_format::binlog {
+
+    struct alignas(64) SegmentHeader {
+        char magic[8];
+        std::uint32_t slots;
+        std::uint64_t ring_size;
+        std::uint64_t capacity;
+        std::uint64_t meta_capacity;
+    };
+
+    struct alignas(64) SlotState {
+        //Pid of the process owning the slot, 0 when free. Only the collector frees slots, after draining them.
+        std::atomic<std::int32_t> owner;
+        //Set by the owner on exit
+        std::atomic<std::uint32_t> closed;
+        //Odd while a new owner sets up the ring, then the next even value. An owner that died during setup leaves it odd
+        //until the collector frees the slot, so a claim starts from either parity.
+        std::atomic<std::uint32_t> generation;
+    };
+
+    static_assert(std::atomic<std::int32_t>::is_always_lock_free && std::atomic<std::uint32_t>::is_always_lock_free,
+        "Slot states must be lock-free to live in shared memory");
+
+    //Mapping of a shared memory segment, created by the collector and opened by writers
+    class SharedRings {
+        void* memory = MAP_FAILED;
+        std::size_t size = 0;
+
+        constexpr static char magic[8] = {'C','F','S','H','M','\0','\0','\1'};
+
+        SegmentHeader& header() const {return *static_cast<SegmentHeader*>(memory);}
+
+        static std::size_t slots_offset() {return sizeof(SegmentHeader);}
+        std::size_t rings_offset() const {return slots_offset()+header().slots*sizeof(SlotState);}
+
+        static void* map(int fd, std::size_t n) {
+            void* m = ::mmap(nullptr,n,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+            ::close(fd);
+            return m;
+        }
+    public:
+        SharedRings() = default;
+
+        //Creates or replaces the segment name (starting with '/'), with slots rings of the given capacities
+        static SharedRings create(const char* name, std::uint32_t slots, std::size_t capacity, std::size_t meta_capacity = 64*1024) {
+            const auto ring_size = (Ring::required_size(capacity,meta_capacity)+63) & ~std::size_t(63);
+            const auto n = sizeof(SegmentHeader)+slots*sizeof(SlotState)+slots*ring_size;
+            ::shm_unlink(name);
+            const int fd = ::shm_open(name,O_RDWR|O_CREAT|O_EXCL,0600);
+            if(fd < 0) return {};
+            SharedRings s;
+            if(::ftruncate(fd,static_cast<off_t>(n)) != 0) {
+                ::close(fd);
+                return s;
+            }
+            s.memory = map(fd,n);
+            if(s.memory == MAP_FAILED) return s;
+            s.size = n;
+
+            auto& h = s.header();
+            h.slots = slots;
+            h.ring_size = ring_size;
+            h.capacity = capacity;
+            h.meta_capacity = meta_capacity;
+            //Last, writers check the magic before looking at anything else
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memcpy(h.magic,magic,sizeof(magic));
+            return s;
+        }
+
+        //Segment set up by create, invalid if it doesn't exist or isn't a segment
+        static SharedRings open(const char* name) {
+            const int fd = ::shm_open(name,O_RDWR,0);
+            if(fd < 0) return {};
+            struct stat st;
+            SharedRings s;
+            if(::fstat(fd,&st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(SegmentHeader)) {
+                ::close(fd);
+                return s;
+            }
+            s.memory = map(fd,st.st_size);
+            if(s.memory == MAP_FAILED) return s;
+            s.size = st.st_size;
+            if(std::memcmp(s.header().magic,magic,sizeof(magic)) != 0 || s.size < s.rings_offset()+s.slot_count()*s.header().ring_size) {
+                return {};
+            }
+            return s;
+        }
+
+        static void unlink(const char* name) {
+            ::shm_unlink(name);
+        }
+
+        SharedRings(SharedRings&& other) noexcept : memory(other.memory), size(other.size) {
+            other.memory = MAP_FAILED;
+        }
+
+        SharedRings& operator=(SharedRings&& other) noexcept {
+            std::swap(memory,other.memory);
+            std::swap(size,other.size);
+            return *this;
+        }
+
+        ~SharedRings() {
+            if(memory != MAP_FAILED) ::munmap(memory,size);
+        }
+
+        explicit operator bool() const {return memory != MAP_FAILED;}
+
+        std::uint32_t slot_count() const {return header().slots;}
+
+        SlotState& state(std::uint32_t slot) const {
+            return reinterpret_cast<SlotState*>(static_cast<char*>(memory)+slots_offset())[slot];
+        }
+
+        void* ring_memory(std::uint32_t slot) const {
+            return static_cast<char*>(memory)+rings_offset()+slot*header().ring_size;
+        }
+
+        std::size_t ring_size() const {return header().ring_size;}
+
+        Ring create_ring(std::uint32_t slot) const {
+            return Ring::create(ring_memory(slot),header().capacity,header().meta_capacity);
+        }
+
+        Ring attach_ring(std::uint32_t slot) const {
+            return Ring::attach(ring_memory(slot),header().ring_size);
+        }
+    };
+
+    //A writer process's slot in a segment, used as the output of a Writer. Invalid if every slot is taken.
+    class ProcessRing : public Ring {
+        const SharedRings* segment = nullptr;
+        std::uint32_t slot = 0;
+    public:
+        //The placement applies to pages the slot hasn't used before, a reused slot keeps the pages of its previous owner
+        explicit ProcessRing(const SharedRings& rings, memory::Placement placement = {}) {
+            const auto pid = static_cast<std::int32_t>(::getpid());
+            for(std::uint32_t i = 0; i < rings.slot_count(); ++i) {
+                auto& s = rings.state(i);
+                std::int32_t expected = 0;
+                if(!s.owner.compare_exchange_strong(expected,pid,std::memory_order_acquire)) continue;
+                const auto previous = s.generation.load(std::memory_order_relaxed);
+                const auto setup = previous+(previous % 2 == 0 ? 1 : 2);
+                s.generation.store(setup,std::memory_order_relaxed);
+                memory::place(rings.ring_memory(i),rings.ring_size(),placement);
+                static_cast<Ring&>(*this) = rings.create_ring(i);
+                s.closed.store(0,std::memory_order_relaxed);
+                s.generation.store(setup+1,std::memory_order_release);
+                segment = &rings;
+                slot = i;
+                return;
+            }
+        }
+
+        ProcessRing(const ProcessRing&) = delete;
+        ProcessRing& operator=(const ProcessRing&) = delete;
+
+        //The slot stays owned until the collector has drained it
+        ~ProcessRing() {
+            if(segment) segment->state(slot).closed.store(1,std::memory_order_release);
+        }
+
+        explicit operator bool() const {return segment != nullptr;}
+    };
+
+    namespace detail {
+        //Size of the definition record at in, 0 if it is incomplete
+        inline std::size_t definition_size(const char* in, const char* end) {
+            const auto available = static_cast<std::size_t>(end-in);
+            std::size_t n = 1+4+4+1;
+            if(available < n) return 0;
+            n += static_cast<std::uint8_t>(in[9]);
+            for(int field = 0; field < 2; ++field) {
+                if(available < n+2) return 0;
+                std::uint16_t len;
+                std::memcpy(&len,in+n,2);
+                n += 2+len;
+            }
+            return available < n ? 0 : n;
+        }
+
+        inline bool process_gone(std::int32_t pid) {
+            return ::kill(pid,0) != 0 && errno == ESRCH;
+        }
+    }
+
+    //Drains the slots of a segment into one stream, sorted by timestamp. Messages are held back for the given delay
+    //so that late messages of slower processes still get sorted in, any message older than that is written as it arrives.
+    class Collector {
+        struct Slot {
+            std::uint32_t generation = 0;
+            std::uint64_t cursor = 0;
+            std::size_t meta_seen = 0;
+            //Site ids of the process mapped to ids in the merged stream
+            std::vector<std::uint32_t> ids;
+            //Definition records of the process by its site ids
+            std::vector<std::string> definitions;
+        };
+
+        struct Pending {
+            std::uint64_t ticks;
+            std::string record;
+        };
+
+        const SharedRings& rings;
+        std::FILE* out;
+        std::uint64_t hold_ticks;
+        std::vector<Slot> slots;
+        std::vector<Pending> pending;
+        std::vector<char> buffer;
+        std::string record;
+        std::uint32_t next_id = 1;
+        std::uint64_t lost_bytes = 0;
+
+        constexpr static std::size_t stream_header_size = sizeof(detail::header_magic)+sizeof(Calibration);
+
+        void write_record(const char* p, std::size_t n) {
+            std::fwrite(p,1,n,out);
+        }
+
+        //Writes the definition of a site of the slot under a new merged id
+        void write_definition(Slot& slot, std::uint32_t id) {
+            slot.ids[id] = next_id++;
+            record = slot.definitions[id];
+            std::memcpy(record.data()+1,&slot.ids[id],4);
+            write_record(record.data(),record.size());
+        }
+
+        //Copies new definitions of the slot to the output under merged ids
+        void read_definitions(const Ring& ring, Slot& slot) {
+            const auto meta = ring.meta_contents();
+            if(slot.meta_seen == 0) {
+                if(meta.size() < stream_header_size) return;
+                slot.meta_seen = stream_header_size;
+            }
+            const char* const end = meta.begin()+meta.size();
+            while(slot.meta_seen < meta.size()) {
+                const char* in = meta.begin()+slot.meta_seen;
+                const auto n = detail::definition_size(in,end);
+                if(n == 0 || *in != 'D') break;
+                std::uint32_t id;
+                std::memcpy(&id,in+1,4);
+                if(!detail::plausible_id(id,slot.ids.size())) break;
+                if(slot.ids.size() <= id) {
+                    slot.ids.resize(id+1,0);
+                    slot.definitions.resize(id+1);
+                }
+                slot.definitions[id].assign(in,n);
+                write_definition(slot,id);
+                slot.meta_seen += n;
+            }
+        }
+
+        void read_messages(const Ring& ring, Slot& slot) {
+            const auto collect = [&](const char* p, std::size_t n) {
+                std::uint32_t id;
+                if(n < 13 || (*p != 'M' && *p != 'A')) return;
+                std::memcpy(&id,p+1,4);
+                //The site may have been defined after the definitions were read, committing the message published it
+                if(id >= slot.ids.size() || slot.ids[id] == 0) read_definitions(ring,slot);
+                if(id >= slot.ids.size() || slot.ids[id] == 0) return;
+                Pending m{0,std::string(p,n)};
+                std::memcpy(&m.ticks,p+5,8);
+                std::memcpy(m.record.data()+1,&slot.ids[id],4);
+                pending.push_back(std::move(m));
+            };
+            //Messages after a gap can't be decoded against the ones before it, so every site of the slot gets a new
+            //merged id and its delta arguments decode again from its next 'A' message on
+            while(const auto lost = ring.read(slot.cursor,buffer,collect)) {
+                lost_bytes += lost;
+                for(std::uint32_t id = 0; id < slot.definitions.size(); ++id) {
+                    if(slot.ids[id] != 0) write_definition(slot,id);
+                }
+            }
+        }
+
+        //Writes the pending messages older than limit in timestamp order
+        void write_pending(std::uint64_t limit) {
+            const auto ready = std::stable_partition(pending.begin(),pending.end(),[&](const Pending& m) {return m.ticks < limit;});
+            std::stable_sort(pending.begin(),ready,[](const Pending& a, const Pending& b) {return a.ticks < b.ticks;});
+            for(auto it = pending.begin(); it != ready; ++it) {
+                write_record(it->record.data(),it->record.size());
+            }
+            pending.erase(pending.begin(),ready);
+        }
+    public:
+        Collector(const SharedRings& rings, std::FILE* out, std::chrono::milliseconds hold = std::chrono::milliseconds(100),
+                const Calibration& calibration = process_calibration()) :
+            rings(rings), out(out), slots(rings.slot_count()) {
+            hold_ticks = static_cast<std::uint64_t>(calibration.ticks_per_second*std::chrono::duration<double>(hold).count());
+            write_record(detail::header_magic,sizeof(detail::header_magic));
+            write_record(reinterpret_cast<const char*>(&calibration),sizeof(Calibration));
+        }
+
+        //One pass over every slot. Slots whose owner exited or died are freed once drained.
+        void drain() {
+            for(std::uint32_t i = 0; i < rings.slot_count(); ++i) {
+                auto& state = rings.state(i);
+                const auto owner = state.owner.load(std::memory_order_acquire);
+                if(owner == 0) continue;
+                const bool closed = state.closed.load(std::memory_order_acquire) != 0 || detail::process_gone(owner);
+
+                auto& slot = slots[i];
+                const auto generation = state.generation.load(std::memory_order_acquire);
+                if(generation % 2 == 0) {
+                    if(generation != slot.generation) {
+                        slot = Slot();
+                        slot.generation = generation;
+                    }
+                    const auto held = pending.size();
+                    if(const auto ring = rings.attach_ring(i)) {
+                        read_definitions(ring,slot);
+                        read_messages(ring,slot);
+                    }
+                    //Claimed by a new owner between loading the generation and reading, the records read may be the new
+                    //owner's under the previous owner's state. They are dropped and read again from the start next pass.
+                    if(state.generation.load(std::memory_order_acquire) != generation) {
+                        pending.erase(pending.begin()+held,pending.end());
+                        continue;
+                    }
+                }
+                if(closed) {
+                    //Emptied before the slot is given up, so the next owner's ring never shows this owner's records
+                    if(auto ring = rings.attach_ring(i)) ring.clear();
+                    //Even again if the owner died while setting up
+                    const auto freed = generation+generation % 2;
+                    state.generation.store(freed,std::memory_order_relaxed);
+                    slot = Slot();
+                    slot.generation = freed;
+                    state.closed.store(0,std::memory_order_relaxed);
+                    state.owner.store(0,std::memory_order_release);
+                }
+            }
+            write_pending(ticks()-hold_ticks);
+        }
+
+        //Writes everything still held back, e.g. before exiting
+        void flush() {
+            write_pending(~std::uint64_t(0));
+            std::fflush(out);
+        }
+
+        //Drains every interval until stop is set, then flushes
+        void run(const std::atomic<bool>& stop, std::chrono::milliseconds interval = std::chrono::milliseconds(10)) {
+            while(!stop.load(std::memory_order_relaxed)) {
+                drain();
+                std::fflush(out);
+                std::this_thread::sleep_for(interval);
+            }
+            drain();
+            flush();
+        }
+
+        //Bytes of messages the writers overwrote before they were collected
+        std::uint64_t lost() const {return lost_bytes;}
+    };
+
+}
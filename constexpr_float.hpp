@@ -0,0 +1,128 @@
+#pragma once
+
+#include "constexpr_format.hpp"
+
+#include <charconv>
+#include <cstdlib>
+#include <vector>
+
+//Shortest round-trip conversion of doubles, one at a time or in batches for exporting large arrays.
+//The output is that of std::to_chars without a format: the fewest digits that read back as the same double,
+//in fixed or scientific notation, whichever is shorter (fixed on ties), and "inf", "-inf", "nan".
+//Batches are processed in blocks: a branch-free pass classifies every value of the block, so the compiler can
+//vectorize it, then small integers (counters, sizes, ...) are written with the integer digit code and the rest
+//goes through the shortest conversion. Only integral values are faster in a batch, fractional values cost the same
+//as converting them one at a time.
+namespace constexpr_format::shortest {
+
+    //Longest output, e.g. -2.2250738585072014e-308
+    constexpr std::size_t max_size = 24;
+
+    inline char* write(char* out, double v) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        return std::to_chars(out,out+max_size,v).ptr;
+#else
+        //17 significant digits always round-trip, try fewer first
+        char buffer[32];
+        int n = 0;
+        for(int precision = 1; precision <= 17; ++precision) {
+            n = std::snprintf(buffer,sizeof(buffer),"%.*g",precision,v);
+            if(std::strtod(buffer,nullptr) == v || v != v) break;
+        }
+        std::memcpy(out,buffer,n);
+        return out+n;
+#endif
+    }
+
+    namespace detail {
+        constexpr std::size_t block_size = 64;
+
+        //Integers below this are exact and their fixed notation has at most 16 digits, so the exponent has 2
+        constexpr double integer_limit = 9007199254740992.0;
+
+        inline std::size_t trailing_zeros(std::uint64_t n) {
+            std::size_t count = 0;
+            while(n % 10 == 0) {
+                n /= 10;
+                ++count;
+            }
+            return count;
+        }
+
+        //Fixed notation of an integer, if to_chars would pick it over scientific
+        inline bool write_integer(char*& out, bool negative, std::uint64_t n) {
+            const auto digits = util::count_digits(n);
+            if(digits > 3 && n != 0) {
+                const auto significant = digits-trailing_zeros(n);
+                if(significant+(significant > 1)+4 < digits) return false;
+            }
+            if(negative) *out++ = '-';
+            out = util::write_digits(out,n,digits);
+            return true;
+        }
+    }
+
+    //Writes the values back to back into out, which needs room for n*max_size characters.
+    //offsets gets n+1 entries, value i is [out+offsets[i], out+offsets[i+1]). Returns the number of characters written.
+    inline std::size_t write(const double* values, std::size_t n, char* out, std::uint32_t* offsets) {
+        char* p = out;
+        std::uint64_t magnitudes[detail::block_size];
+        bool integral[detail::block_size];
+        bool negative[detail::block_size];
+
+        for(std::size_t start = 0; start < n; start += detail::block_size) {
+            const std::size_t count = std::min(detail::block_size,n-start);
+            const double* block = values+start;
+
+            //Classification without branches
+            for(std::size_t i = 0; i < count; ++i) {
+                const double v = block[i];
+                const double m = v < 0 ? -v : v;
+                const bool small = m < detail::integer_limit;
+                const auto truncated = static_cast<std::uint64_t>(small ? m : 0.0);
+                integral[i] = small & (static_cast<double>(truncated) == m);
+                magnitudes[i] = truncated;
+                negative[i] = std::signbit(v);
+            }
+
+            for(std::size_t i = 0; i < count; ++i) {
+                offsets[start+i] = static_cast<std::uint32_t>(p-out);
+                if(!integral[i] || !detail::write_integer(p,negative[i],magnitudes[i])) {
+                    p = write(p,block[i]);
+                }
+            }
+        }
+        offsets[n] = static_cast<std::uint32_t>(p-out);
+        return static_cast<std::size_t>(p-out);
+    }
+
+    //Owning result of a batch conversion
+    class Batch {
+        std::vector<char> chars;
+        std::vector<std::uint32_t> offsets{0};
+    public:
+        Batch() = default;
+
+        Batch(const double* values, std::size_t n) {
+            assign(values,n);
+        }
+
+        explicit Batch(const std::vector<double>& values) : Batch(values.data(),values.size()) {}
+
+        void assign(const double* values, std::size_t n) {
+            chars.resize(n*max_size);
+            offsets.resize(n+1);
+            chars.resize(write(values,n,chars.data(),offsets.data()));
+        }
+
+        std::size_t size() const {return offsets.size()-1;}
+
+        util::string_view operator[](std::size_t i) const {
+            return {chars.data()+offsets[i],offsets[i+1]-offsets[i]};
+        }
+
+        //All values back to back, without separators
+        util::string_view data() const {return {chars.data(),chars.size()};}
+    };
+
+}
@@ -3,16 +3,25 @@
 #include <array>
 #include <tuple>
 #include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
 
 namespace constexpr_format {
 
     //Utility data structures and functions
     namespace util {
 
-        //Wrapper for std::array<char,N> to not overload operator+ on std::array for anyone using this namespace.
+        //Wrapper for std::array<char,N+1> to not overload operator+ on std::array for anyone using this namespace.
+        //The extra element is always '\0' so the contents can be handed to C APIs without a copy, size() stays N.
         template<std::size_t N>
         struct static_string {
-            std::array<char,N> string;
+            std::array<char,N+1> string;
 
             constexpr decltype(auto) operator[](std::size_t n) {return string[n];}
             constexpr decltype(auto) operator[](std::size_t n) const {return string[n];}
@@ -20,26 +29,31 @@ namespace constexpr_format {
             constexpr decltype(auto) data() {return string.data();}
             constexpr decltype(auto) data() const {return string.data();}
 
+            constexpr const char* c_str() const {return string.data();}
+
             constexpr auto size() const {return N;}
 
             constexpr auto begin() {return string.begin();}
             constexpr auto begin() const {return string.begin();}
 
-            constexpr auto end() {return string.end();}
-            constexpr auto end() const {return string.end();}
+            constexpr auto end() {return string.begin()+N;}
+            constexpr auto end() const {return string.begin()+N;}
 
-            constexpr std::array<char,N+1> getNullTerminatedString() {
-                return (*this + static_string<1>{{'\0'}}).string;
+            constexpr const std::array<char,N+1>& getNullTerminatedString() const {
+                return string;
             }
         };
 
+        namespace detail {
+            template<std::size_t N, std::size_t M, std::size_t... I, std::size_t... J>
+            constexpr auto concat_impl(const static_string<N>& a, const static_string<M>& b, std::index_sequence<I...>, std::index_sequence<J...>) {
+                return static_string<N+M>{{a[I]...,b[J]...}};
+            }
+        }
+
         template<std::size_t N, std::size_t M>
-        constexpr auto operator+(static_string<N> a, static_string<M> b) {
-            return std::apply([&](const auto&... as) {
-                return std::apply([&](const auto&... bs) {
-                    return static_string<N+M>{{as...,bs...}};
-                }, b.string);
-            }, a.string);
+        constexpr auto operator+(const static_string<N>& a, const static_string<M>& b) {
+            return detail::concat_impl(a,b,std::make_index_sequence<N>{},std::make_index_sequence<M>{});
         }
 
         //Simple constexpr-enabled string_view for views on char arrays
@@ -50,8 +64,10 @@ namespace constexpr_format {
             template<int N>
             constexpr string_view(const char (&init)[N]) : data(init),n(init[N-1]=='\0'?N-1:N) {};
 
+            constexpr string_view(std::string_view s) : data(s.data()),n(s.size()) {};
+
             template<std::size_t N>
-            constexpr string_view(const static_string<N>& array) : data(array.string.data()), n(array[N-1]=='\0'?N-1:N) {};
+            constexpr string_view(const static_string<N>& array) : data(array.c_str()), n(N > 0 && array[N-1]=='\0'?N-1:N) {};
 
             constexpr string_view(const char* init, std::size_t len) : data(init),n(len) {};
 
@@ -98,7 +114,7 @@ namespace constexpr_format {
         }
 
         template<std::size_t... I>
-        constexpr auto view_to_static_impl(string_view s, std::index_sequence<I...>) {
+        constexpr auto view_to_static_impl([[maybe_unused]] string_view s, std::index_sequence<I...>) {
             return static_string<sizeof...(I)>{{s[I]...}};
         }
 
@@ -136,6 +152,115 @@ namespace constexpr_format {
             },a);
         }
 
+        //Types accepted by %s, char arrays are checked after decay
+        template<typename T>
+        struct is_string_like : std::disjunction<
+            std::is_same<T,string_view>,
+            std::is_same<T,std::string_view>,
+            std::is_same<T,std::string>,
+            std::is_same<T,const char*>,
+            std::is_same<T,char*>> {};
+
+        constexpr string_view to_view(string_view s) {return s;}
+        constexpr string_view to_view(const char* s) {
+            std::size_t n = 0;
+            while(s[n] != '\0') ++n;
+            return {s,n};
+        }
+        inline string_view to_view(const std::string& s) {return {s.data(),s.size()};}
+
+        //Runtime helpers for writing integers, digits are written back to front two at a time
+        constexpr char digit_pairs[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+
+        template<typename U>
+        constexpr std::size_t count_digits(U n) {
+            std::size_t count = 1;
+            for(;;) {
+                if(n < 10) return count;
+                if(n < 100) return count+1;
+                if(n < 1000) return count+2;
+                if(n < 10000) return count+3;
+                n /= 10000;
+                count += 4;
+            }
+        }
+
+        //Writes n as exactly len digits ending at out+len, zero-filled on the left, returns out+len
+        template<typename U>
+        constexpr char* write_digits(char* out, U n, std::size_t len) {
+            char* end = out+len;
+            char* p = end;
+            while(n >= 100) {
+                const auto pair = static_cast<std::size_t>(n%100)*2;
+                n /= 100;
+                *--p = digit_pairs[pair+1];
+                *--p = digit_pairs[pair];
+            }
+            if(n >= 10) {
+                const auto pair = static_cast<std::size_t>(n)*2;
+                *--p = digit_pairs[pair+1];
+                *--p = digit_pairs[pair];
+            } else {
+                *--p = static_cast<char>('0'+n);
+            }
+            while(p > out) *--p = '0';
+            return end;
+        }
+
+        //Complete digit tables for 8 and 16 bit magnitudes, so formatting them is a single lookup and copy.
+        //Generated at compile time, only when a formatter of that width is used.
+        template<std::size_t Width>
+        struct DigitEntry {
+            char digits[Width];
+            std::uint8_t len;
+        };
+
+        template<std::size_t Count, std::size_t Width>
+        constexpr auto make_digit_table() {
+            std::array<DigitEntry<Width>,Count> table{};
+            for(std::size_t v = 0; v < Count; ++v) {
+                auto& e = table[v];
+                e.len = static_cast<std::uint8_t>(count_digits(v));
+                for(std::size_t n = v, i = e.len; i-- > 0; n /= 10) {
+                    e.digits[i] = static_cast<char>('0'+n%10);
+                }
+            }
+            return table;
+        }
+
+        template<std::size_t Bytes>
+        struct DigitTable;
+
+        template<>
+        struct DigitTable<1> {
+            constexpr static auto entries = make_digit_table<256,3>();
+        };
+
+        template<>
+        struct DigitTable<2> {
+            constexpr static auto entries = make_digit_table<65536,5>();
+        };
+
+        inline char* copy(char* out, string_view s) {
+            std::memcpy(out,s.begin(),s.size());
+            return out+s.size();
+        }
+
+        //copy for constant expressions, e.g. to build format strings
+        constexpr char* put(char* out, string_view s) {
+            for(char c : s) *out++ = c;
+            return out;
+        }
+
+        //References to the elements First, First+1, ... of a tuple of arguments
+        template<std::size_t First, typename ArgTup, std::size_t... I>
+        auto slice(const ArgTup& args, std::index_sequence<I...>) {
+            return std::forward_as_tuple(std::get<First+I>(args)...);
+        }
+
     }
 
     template<char...>
@@ -176,17 +301,472 @@ namespace constexpr_format {
                 }
             }
         }
+
+        //Runtime, size/write only cover the digits, the sign is placed by the caller.
+        //8 and 16 bit types use the complete digit tables, wider ones convert two digits at a time.
+        using U = std::conditional_t<(sizeof(T) <= 4),std::uint32_t,std::uint64_t>;
+        constexpr static bool tabled = sizeof(T) <= 2 && !std::is_same_v<T,bool>;
+
+        constexpr static U magnitude(T v) {
+            if constexpr (std::is_signed_v<T>) {
+                return v < 0 ? U(0)-U(v) : U(v);
+            } else {
+                return U(v);
+            }
+        }
+        constexpr static bool negative(T v) {
+            if constexpr (std::is_signed_v<T>) {
+                return v < 0;
+            } else {
+                return false;
+            }
+        }
+        //Most digits of any value and whether there can be a minus sign, for max_formatted_size
+        constexpr static std::size_t max_size = std::max(util::count_digits(magnitude(std::numeric_limits<T>::min())),
+            util::count_digits(magnitude(std::numeric_limits<T>::max())));
+        constexpr static bool can_be_negative = std::is_signed_v<T>;
+
+        static std::size_t size(T v) {
+            if constexpr (tabled) {
+                return util::DigitTable<sizeof(T)>::entries[magnitude(v)].len;
+            } else {
+                return util::count_digits(magnitude(v));
+            }
+        }
+        static char* write(char* out, T v, std::size_t len) {
+            if constexpr (tabled) {
+                const auto& e = util::DigitTable<sizeof(T)>::entries[magnitude(v)];
+                if(len == e.len) {
+                    std::memcpy(out,e.digits,len);
+                    return out+len;
+                }
+            }
+            return util::write_digits(out,magnitude(v),len);
+        }
     };
 
-    template<>
-    struct Format<util::string_view> {
+    template<typename T>
+    struct Format<T,std::enable_if_t<util::is_string_like<T>::value && !std::is_pointer_v<T>>> {
         template<typename StringF>
         constexpr static auto get_string(StringF f) {
-            constexpr auto s = f();
+            constexpr auto s = util::to_view(f());
+            return util::view_to_static<s.size()>(s);
+        };
+
+        //Runtime, bytes are copied straight from the argument
+        static std::size_t size(const T& v) {
+            return util::to_view(v).size();
+        }
+        static char* write(char* out, const T& v, std::size_t len) {
+            return util::copy(out,util::to_view(v).prefix(len));
+        }
+    };
+
+    //C strings take the precision themselves, so %.Ns never reads more than N characters of them
+    template<typename T>
+    struct Format<T,std::enable_if_t<util::is_string_like<T>::value && std::is_pointer_v<T>>> {
+        constexpr static bool uses_precision = true;
+
+        template<int Precision, typename StringF>
+        constexpr static auto get_string(StringF f) {
+            constexpr auto s = bounded(f(),Precision);
             return util::view_to_static<s.size()>(s);
         };
+
+        constexpr static util::string_view bounded(const char* v, int precision) {
+            std::size_t n = 0;
+            while((precision < 0 || n < static_cast<std::size_t>(precision)) && v[n] != '\0') ++n;
+            return {v,n};
+        }
+
+        template<typename Precision>
+        static std::size_t size(const char* v, Precision p) {
+            if(static_cast<int>(p) < 0) return std::strlen(v);
+            return bounded(v,static_cast<int>(p)).size();
+        }
+        template<typename Precision>
+        static char* write(char* out, const char* v, std::size_t len, Precision) {
+            std::memcpy(out,v,len);
+            return out+len;
+        }
+    };
+
+    namespace util {
+        constexpr std::uint64_t pow10_table[] = {
+            1ull,10ull,100ull,1000ull,10000ull,100000ull,1000000ull,10000000ull,100000000ull,1000000000ull,
+            10000000000ull,100000000000ull,1000000000000ull,10000000000000ull,100000000000000ull,1000000000000000ull,
+            10000000000000000ull,100000000000000000ull,1000000000000000000ull,10000000000000000000ull
+        };
+
+        //Sign bit of v, set for -0.0 too. Also in constant expressions, where 1/v isn't one for v == 0.
+        constexpr bool sign_bit(double v) {
+#if defined(__GNUC__)
+            return __builtin_copysign(1.0,v) < 0;
+#else
+            return v < 0;
+#endif
+        }
+
+        //Rounding error of the product p = a*b, so that a*b == p+error exactly (Dekker). Valid for |a|,|b| < 2^996.
+        constexpr double product_error(double a, double b, double p) {
+            constexpr double splitter = 134217729.0; //2^27+1
+            const double ta = splitter*a, tb = splitter*b;
+            const double ah = ta-(ta-a), al = a-ah;
+            const double bh = tb-(tb-b), bl = b-bh;
+            return ((ah*bh-p)+ah*bl+al*bh)+al*bl;
+        }
+
+        //Rounds m*10^precision to the nearest integer exactly like printf does (ties to even), for m >= 0.
+        //False when the result doesn't stay below 2^52, where the doubles no longer have a fractional part to round.
+        constexpr bool scale_decimal(double m, int precision, std::uint64_t& n) {
+            const double scale = static_cast<double>(pow10_table[precision]);
+            const double r = m*scale;
+            if(!(r < 4503599627370496.0)) return false;
+            const double e = product_error(m,scale,r);
+            n = static_cast<std::uint64_t>(r);
+            const double frac = r-static_cast<double>(n);
+            //frac is a multiple of ulp(r) and |e| is at most half of it, so e only matters on an exact half
+            if(frac > 0.5 || (frac == 0.5 && (e > 0 || (e == 0 && (n & 1))))) ++n;
+            return true;
+        }
+    }
+
+    //%f. Precisions up to 9 with values that scale below 2^52 are converted by rounding value*10^precision to an integer
+    //and inserting the decimal point, which is exact. Anything else goes through snprintf. At compile time only the first case is supported.
+    template<typename T>
+    struct Format<T,std::enable_if_t<std::is_floating_point_v<T>>> {
+        //The formatter consumes the precision, it isn't applied as a minimum digit count by the layout
+        constexpr static bool uses_precision = true;
+        constexpr static int default_precision = 6;
+        constexpr static int max_fast_precision = 9;
+        constexpr static bool fast_type = !std::is_same_v<T,long double>;
+
+        struct Digits {
+            char chars[40] = {};
+            std::size_t size = 0;
+        };
+
+        //Digits of |v| for the fast path, size 0 when it doesn't apply
+        constexpr static Digits fast_digits(T v, int precision) {
+            Digits d;
+            const double m = v < 0 ? -static_cast<double>(v) : static_cast<double>(v);
+            if(!(m == m) || m > 1.7976931348623157e308) {
+                const char* word = m == m ? "inf" : "nan";
+                for(; d.size < 3; ++d.size) d.chars[d.size] = word[d.size];
+                return d;
+            }
+            std::uint64_t n = 0;
+            if(!util::scale_decimal(m,precision,n)) return d;
+            const auto scale = util::pow10_table[precision];
+            const std::uint64_t integer = n/scale;
+            std::uint64_t fraction = n%scale;
+            d.size = util::count_digits(integer)+(precision > 0 ? 1+precision : 0);
+            std::size_t i = d.size;
+            for(int k = 0; k < precision; ++k, fraction /= 10) {
+                d.chars[--i] = static_cast<char>('0'+fraction%10);
+            }
+            if(precision > 0) d.chars[--i] = '.';
+            std::uint64_t rest = integer;
+            do {
+                d.chars[--i] = static_cast<char>('0'+rest%10);
+                rest /= 10;
+            } while(rest != 0);
+            return d;
+        }
+
+        template<int Precision, typename FloatF>
+        constexpr static auto get_string(FloatF f) {
+            constexpr int precision = Precision < 0 ? default_precision : Precision;
+            static_assert(fast_type && precision <= max_fast_precision, "Compile-time %f supports float and double up to precision 9");
+            constexpr T v = f();
+            constexpr auto d = fast_digits(v,precision);
+            static_assert(d.size > 0, "Value out of range for compile-time %f");
+            constexpr bool negative = util::sign_bit(static_cast<double>(v));
+            if constexpr(negative) {
+                return util::static_string<1>{{'-'}}+util::view_to_static<d.size>(util::string_view(d.chars,d.size));
+            } else {
+                return util::view_to_static<d.size>(util::string_view(d.chars,d.size));
+            }
+        }
+
+        //inf and nan are padded with spaces like printf does, also with the 0 flag
+        constexpr static bool zero_pads(T v) {
+            return v >= -std::numeric_limits<T>::max() && v <= std::numeric_limits<T>::max();
+        }
+
+        //Runtime, Precision is either std::integral_constant<int,P> from the format string or an int from a '*' argument
+        static bool negative(T v) {
+            return std::signbit(v);
+        }
+
+        template<typename Precision>
+        static Digits digits(T v, Precision p) {
+            const int precision = static_cast<int>(p) < 0 ? default_precision : static_cast<int>(p);
+            if constexpr(std::is_same_v<Precision,int>) {
+                if(fast_type && precision <= max_fast_precision) {
+                    return fast_digits(v,precision);
+                }
+                return {};
+            } else if constexpr(fast_type && Precision::value <= max_fast_precision) {
+                return fast_digits(v,precision);
+            } else {
+                return {};
+            }
+        }
+
+        //Converted once by prepare(), then measured and written from the result
+        constexpr static bool uses_prepare = true;
+
+        struct Text {
+            Digits digits;
+            //snprintf output too long for digits
+            std::string spill;
+
+            util::string_view view() const {
+                return spill.empty() ? util::string_view(digits.chars,digits.size) : util::string_view(spill.data(),spill.size());
+            }
+        };
+
+        template<typename Precision>
+        static Text prepare(T v, Precision p) {
+            Text t;
+            t.digits = digits(v,p);
+            if(t.digits.size == 0) exact(t,v,p);
+            return t;
+        }
+
+        static std::size_t size(const Text& t) {
+            return t.view().size();
+        }
+
+        static char* write(char* out, const Text& t, std::size_t len) {
+            std::memcpy(out,t.view().begin(),len);
+            return out+len;
+        }
+
+        //Fallback through the C library, without the sign. Only output too long for the digits allocates.
+        template<typename Precision>
+        static void exact(Text& t, T v, Precision p) {
+            const int precision = static_cast<int>(p) < 0 ? default_precision : static_cast<int>(p);
+            const long double m = std::fabs(static_cast<long double>(v));
+            //Upper bound of the length from the binary exponent, 2^e has at most e*0.30103+1 integer digits
+            int e = 0;
+            std::frexp(m,&e);
+            const std::size_t bound = static_cast<std::size_t>(std::max(e,1))*30103/100000+2+static_cast<std::size_t>(precision)+1;
+            if(bound < sizeof(t.digits.chars)) {
+                t.digits.size = static_cast<std::size_t>(std::snprintf(t.digits.chars,sizeof(t.digits.chars),"%.*Lf",precision,m));
+                return;
+            }
+            t.spill.resize(bound);
+            t.spill.resize(static_cast<std::size_t>(std::snprintf(t.spill.data(),bound+1,"%.*Lf",precision,m)));
+        }
+    };
+
+    template<typename T, typename SFINAE_Check=void>
+    struct uses_precision : std::false_type {};
+
+    template<typename T>
+    struct uses_precision<T,std::enable_if_t<Format<T>::uses_precision>> : std::true_type {};
+
+    template<typename T, typename SFINAE_Check=void>
+    struct uses_prepare : std::false_type {};
+
+    template<typename T>
+    struct uses_prepare<T,std::enable_if_t<Format<T>::uses_prepare>> : std::true_type {};
+
+    //Formatters applying the ' flag take it as a std::bool_constant after the precision
+    template<typename T, typename SFINAE_Check=void>
+    struct uses_grouping : std::false_type {};
+
+    template<typename T>
+    struct uses_grouping<T,std::enable_if_t<Format<T>::uses_grouping>> : std::true_type {};
+
+    //Integer known to lie in [Min,Max], e.g. an hour or a percentage. Its digits are converted in a fixed number
+    //of steps without branching on the digit count, and max_formatted_size only reserves room for the range.
+    //A value outside the range is a bug: it asserts in debug builds and is clamped otherwise, at compile time it doesn't compile.
+    template<typename T, T Min, T Max>
+    struct Ranged {
+        static_assert(std::is_integral_v<T> && Min <= Max, "Ranges need an integer type and Min <= Max");
+        T value;
+    };
+
+    template<auto Min, auto Max, typename T>
+    constexpr Ranged<T,T(Min),T(Max)> in_range(T value) {
+        return {value};
+    }
+
+    template<typename T, T Min, T Max>
+    struct Format<Ranged<T,Min,Max>> {
+        using Base = Format<T>;
+        using U = typename Base::U;
+
+        constexpr static T clamp(T v) {
+            assert(v >= Min && v <= Max && "Ranged value outside its range");
+            return v < Min ? Min : v > Max ? Max : v;
+        }
+
+        constexpr static std::size_t max_size = std::max(util::count_digits(Base::magnitude(Min)),util::count_digits(Base::magnitude(Max)));
+        constexpr static bool can_be_negative = Min < 0;
+
+        template<typename RangedF>
+        constexpr static auto get_string(RangedF f) {
+            static_assert(f().value >= Min && f().value <= Max, "Ranged value outside its range");
+            return Base::get_string([f]{return clamp(f().value);});
+        }
+
+        static bool negative(const Ranged<T,Min,Max>& r) {
+            return Base::negative(clamp(r.value));
+        }
+        static std::size_t size(const Ranged<T,Min,Max>& r) {
+            const U m = Base::magnitude(clamp(r.value));
+            std::size_t n = 1;
+            U power = 10;
+            for(std::size_t i = 1; i < max_size; ++i, power *= 10) {
+                n += m >= power;
+            }
+            return n;
+        }
+        static char* write(char* out, const Ranged<T,Min,Max>& r, std::size_t len) {
+            U m = Base::magnitude(clamp(r.value));
+            char digits[max_size];
+            for(std::size_t i = max_size; i-- > 0; m /= 10) {
+                digits[i] = static_cast<char>('0'+m%10);
+            }
+            if(len > max_size) return util::write_digits(out,Base::magnitude(clamp(r.value)),len);
+            std::memcpy(out,digits+max_size-len,len);
+            return out+len;
+        }
+    };
+
+    template<typename T>
+    struct is_integer_like : std::is_integral<T> {};
+
+    template<typename T, T Min, T Max>
+    struct is_integer_like<Ranged<T,Min,Max>> : std::true_type {};
+
+    //Exact decimal held as an integer number of 10^-Scale units, e.g. Decimal<std::int64_t,2>{12345} is 123.45.
+    //Formatted by %f without going through floating point: the precision defaults to Scale, fewer decimals round
+    //half to even like printf does, more are padded with zeros, and the ' flag groups the integer digits with ','.
+    template<typename T, int Scale>
+    struct Decimal {
+        static_assert(std::is_integral_v<T> && !std::is_same_v<T,bool> && Scale >= 0 && Scale <= 18, "Decimals need an integer type and a scale of 0 to 18");
+        T units;
+    };
+
+    template<typename T, int Scale>
+    struct Format<Decimal<T,Scale>> {
+        using Base = Format<T>;
+        constexpr static bool uses_precision = true;
+        constexpr static bool uses_grouping = true;
+
+        //Magnitude in units of 10^-decimals, followed by zeros more decimals
+        struct Scaled {
+            std::uint64_t n;
+            int decimals;
+            int zeros;
+        };
+
+        constexpr static Scaled scale(T units, int precision) {
+            const std::uint64_t m = Base::magnitude(units);
+            if(precision < 0 || precision >= Scale) {
+                return {m,Scale,precision < 0 ? 0 : precision-Scale};
+            }
+            const auto divisor = util::pow10_table[Scale-precision];
+            std::uint64_t n = m/divisor;
+            const auto rest = m%divisor;
+            if(rest > divisor/2 || (rest == divisor/2 && (n & 1))) ++n;
+            return {n,precision,0};
+        }
+
+        constexpr static std::size_t body_size(const Scaled& s, bool group) {
+            const auto digits = util::count_digits(s.n/util::pow10_table[s.decimals]);
+            const std::size_t decimals = s.decimals+s.zeros;
+            return digits+(group ? (digits-1)/3 : 0)+(decimals > 0 ? 1+decimals : 0);
+        }
+
+        constexpr static char* write_body(char* out, const Scaled& s, bool group) {
+            const auto divisor = util::pow10_table[s.decimals];
+            std::uint64_t integer = s.n/divisor;
+            const auto digits = util::count_digits(integer);
+            char* end = out+digits+(group ? (digits-1)/3 : 0);
+            if(group) {
+                char* p = end;
+                for(; integer >= 1000; integer /= 1000) {
+                    p -= 3;
+                    util::write_digits(p,integer%1000,3);
+                    *--p = ',';
+                }
+                util::write_digits(out,integer,p-out);
+            } else {
+                util::write_digits(out,integer,digits);
+            }
+            if(s.decimals+s.zeros > 0) {
+                *end++ = '.';
+                if(s.decimals > 0) end = util::write_digits(end,s.n%divisor,s.decimals);
+                for(int i = 0; i < s.zeros; ++i) *end++ = '0';
+            }
+            return end;
+        }
+
+        template<int Precision, bool Group, typename DecimalF>
+        constexpr static auto get_string(DecimalF f) {
+            constexpr auto d = f();
+            constexpr auto s = scale(d.units,Precision);
+            util::static_string<body_size(s,Group)> body{};
+            write_body(body.data(),s,Group);
+            if constexpr(d.units < 0) {
+                return util::static_string<1>{{'-'}}+body;
+            } else {
+                return body;
+            }
+        }
+
+        //Runtime, Precision is an int or std::integral_constant as for %f, Group a std::bool_constant
+        constexpr static bool negative(const Decimal<T,Scale>& d) {
+            return d.units < 0;
+        }
+
+        template<typename Precision, typename Group>
+        static std::size_t size(const Decimal<T,Scale>& d, Precision p, Group) {
+            return body_size(scale(d.units,static_cast<int>(p)),Group::value);
+        }
+
+        template<typename Precision, typename Group>
+        static char* write(char* out, const Decimal<T,Scale>& d, std::size_t, Precision p, Group) {
+            return write_body(out,scale(d.units,static_cast<int>(p)),Group::value);
+        }
     };
 
+    //Types accepted by %f
+    template<typename T>
+    struct is_real_like : std::is_floating_point<T> {};
+
+    template<typename T, int Scale>
+    struct is_real_like<Decimal<T,Scale>> : std::true_type {};
+
+    //Numeric formatters provide negative(), their output gets sign and zero-padding handling
+    template<typename T, typename SFINAE_Check=void>
+    struct is_numeric_format : std::false_type {};
+
+    template<typename T>
+    struct is_numeric_format<T,std::void_t<decltype(Format<T>::negative(std::declval<const T&>()))>> : std::true_type {};
+
+    //Numeric formatters can refuse the 0 flag for some values with zero_pads(), e.g. %f pads inf and nan with spaces
+    template<typename T, typename SFINAE_Check=void>
+    struct has_zero_pads : std::false_type {};
+
+    template<typename T>
+    struct has_zero_pads<T,std::void_t<decltype(Format<T>::zero_pads(std::declval<const T&>()))>> : std::true_type {};
+
+    template<typename T>
+    constexpr bool zero_pads(const T& v) {
+        if constexpr(has_zero_pads<T>::value) {
+            return Format<T>::zero_pads(v);
+        } else {
+            return true;
+        }
+    }
+
     namespace format_to_typecheck {
         template<typename T>
         struct Id {
@@ -216,8 +796,9 @@ namespace constexpr_format {
         template<char C>
         struct CharV {};
 
-        auto to_type(CharV<'d'>) -> TypeCheck<std::is_integral>;
-        auto to_type(CharV<'s'>) -> Id<util::string_view>;
+        auto to_type(CharV<'d'>) -> TypeCheck<is_integer_like>;
+        auto to_type(CharV<'s'>) -> TypeCheck<util::is_string_like>;
+        auto to_type(CharV<'f'>) -> TypeCheck<is_real_like>;
     }
 
     namespace format_parser {
@@ -249,14 +830,167 @@ namespace constexpr_format {
             bool space = false;             //' ', insert space for positive numbers instead of sign
             bool showsign = false;          //+, always show sign for numeric output
             bool group = false;             //', group digits
+            //Width and precision taken from the argument list
+            bool dynamic_width = false;     //*
+            bool dynamic_precision = false; //.*
 
             char spec;                      //conversion specifier char
         };
 
-        template<typename T, int ParamNum>
+        //Substitute '*' width and precision with their argument values, a negative width left-aligns like printf
+        constexpr FormatOptions resolve_dynamic(FormatOptions o, long long width, long long precision) {
+            if(o.dynamic_width) {
+                if(width < 0) {
+                    o.left = true;
+                    width = -width;
+                }
+                o.width = static_cast<int>(width);
+            }
+            if(o.dynamic_precision) {
+                o.precision = precision < 0 ? -1 : static_cast<int>(precision);
+            }
+            return o;
+        }
+
+        //Options for the layout of a formatter that consumes the precision itself
+        constexpr FormatOptions without_precision(FormatOptions o) {
+            o.precision = -1;
+            return o;
+        }
+
+        //Options with the 0 flag dropped if zero_pad is false
+        constexpr FormatOptions with_zero_pad(FormatOptions o, bool zero_pad) {
+            if(!zero_pad) o.pad = ' ';
+            return o;
+        }
+
+        //Where padding goes around a formatted value of body characters.
+        //Computed from sizes only, so the value never has to be formatted twice.
+        struct FieldLayout {
+            std::size_t left = 0;
+            char sign = '\0';
+            std::size_t zeros = 0;
+            std::size_t body = 0;
+            std::size_t right = 0;
+
+            constexpr std::size_t total() const {return left+(sign != '\0')+zeros+body+right;}
+        };
+
+        constexpr FieldLayout layout(std::size_t body, bool numeric, bool negative, const FormatOptions& o) {
+            FieldLayout l;
+            if(numeric) {
+                l.sign = negative ? '-' : o.showsign ? '+' : o.space ? ' ' : '\0';
+                if(o.precision >= 0 && static_cast<std::size_t>(o.precision) > body) {
+                    l.zeros = o.precision-body;
+                }
+            } else if(o.precision >= 0 && static_cast<std::size_t>(o.precision) < body) {
+                body = o.precision;
+            }
+            l.body = body;
+
+            const std::size_t content = l.total();
+            if(o.width > 0 && static_cast<std::size_t>(o.width) > content) {
+                const std::size_t pad = o.width-content;
+                if(o.left) {
+                    l.right = pad;
+                } else if(numeric && o.pad == '0' && o.precision < 0) {
+                    l.zeros += pad;
+                } else {
+                    l.left = pad;
+                }
+            }
+            return l;
+        }
+
+        //8-byte encoding of FormatOptions for spec tables that are walked at runtime.
+        //Length modifiers are mutually exclusive and the pad is either ' ' or '0', so both fit in a few bits.
+        struct PackedFormatOptions {
+            constexpr static std::uint16_t no_precision = 0xFFFF;
+
+            enum Flags : std::uint8_t {
+                zero_pad = 1 << 0,
+                left = 1 << 1,
+                alt = 1 << 2,
+                space = 1 << 3,
+                showsign = 1 << 4,
+                group = 1 << 5,
+                dynamic_width = 1 << 6,
+                dynamic_precision = 1 << 7
+            };
+
+            enum Length : std::uint8_t {
+                none,
+                hh,
+                h,
+                l,
+                ll
+            };
+
+            std::uint16_t width = 0;
+            std::uint16_t precision = no_precision;
+            std::uint8_t flags = 0;
+            std::uint8_t length = none;
+            char spec = '\0';
+
+            constexpr bool has(Flags f) const {return (flags & f) != 0;}
+
+            //Precision 0xFFFF would read back as no precision
+            constexpr static bool fits(const FormatOptions& o) {
+                return o.width >= 0 && o.width <= 0xFFFF && o.precision < no_precision;
+            }
+
+            //Not constexpr, so packing options that don't fit fails to compile in constant expressions
+            static void too_large_to_pack() {
+                assert(!"Width must be at most 65535 and precision below 65535");
+            }
+
+            constexpr static PackedFormatOptions pack(const FormatOptions& o) {
+                if(!fits(o)) too_large_to_pack();
+                PackedFormatOptions p;
+                p.width = static_cast<std::uint16_t>(o.width);
+                p.precision = o.precision < 0 ? no_precision : static_cast<std::uint16_t>(o.precision);
+                p.flags = static_cast<std::uint8_t>(
+                    (o.pad == '0' ? zero_pad : 0) | (o.left ? left : 0) | (o.alt ? alt : 0) |
+                    (o.space ? space : 0) | (o.showsign ? showsign : 0) | (o.group ? group : 0) |
+                    (o.dynamic_width ? dynamic_width : 0) | (o.dynamic_precision ? dynamic_precision : 0));
+                p.length = o.is_char ? hh : o.is_short ? h : o.is_long ? l : o.is_long_long ? ll : none;
+                p.spec = o.spec;
+                return p;
+            }
+
+            constexpr FormatOptions unpack() const {
+                FormatOptions o{};
+                o.precision = precision == no_precision ? -1 : precision;
+                o.width = width;
+                o.pad = has(zero_pad) ? '0' : ' ';
+                o.left = has(left);
+                o.is_char = length == hh;
+                o.is_short = length == h;
+                o.is_long = length == l;
+                o.is_long_long = length == ll;
+                o.alt = has(alt);
+                o.space = has(space);
+                o.showsign = has(showsign);
+                o.group = has(group);
+                o.dynamic_width = has(dynamic_width);
+                o.dynamic_precision = has(dynamic_precision);
+                o.spec = spec;
+                return o;
+            }
+        };
+        static_assert(sizeof(PackedFormatOptions) <= 8, "PackedFormatOptions should stay within 8 bytes");
+
+        //WidthParam and PrecisionParam are the arguments consumed by '*', -1 if unused
+        template<typename T, int ParamNum, int WidthParam=-1, int PrecisionParam=-1>
         struct FormatSpec {
             using type = T;
             constexpr static int num = ParamNum;
+            constexpr static int width_num = WidthParam;
+            constexpr static int precision_num = PrecisionParam;
+
+            //Type of the argument this spec formats in a call with argument tuple Tup, selecting its Format statically
+            template<typename Tup>
+            using arg_type = std::decay_t<std::tuple_element_t<ParamNum,Tup>>;
         };
 
         template<typename FmtSpec>
@@ -273,14 +1007,88 @@ namespace constexpr_format {
             //TODO
         }
 
+        struct ParsedOptions {
+            FormatOptions opts;
+            std::size_t spec_index;
+        };
+
+        constexpr bool is_digit(char c) {return c >= '0' && c <= '9';}
+
+        //Parses %[flags][width][.precision][length]spec, s starts at the %
+        constexpr ParsedOptions parse_printf_options(util::string_view s) {
+            FormatOptions o{};
+            std::size_t i = 1;
+            for(; i < s.size(); ++i) {
+                const char c = s[i];
+                if(c == '-') o.left = true;
+                else if(c == '0') o.pad = '0';
+                else if(c == '+') o.showsign = true;
+                else if(c == ' ') o.space = true;
+                else if(c == '#') o.alt = true;
+                else if(c == '\'') o.group = true;
+                else break;
+            }
+            if(i < s.size() && s[i] == '*') {
+                o.dynamic_width = true;
+                ++i;
+            } else {
+                for(; i < s.size() && is_digit(s[i]); ++i) {
+                    o.width = o.width*10 + (s[i]-'0');
+                }
+            }
+            if(i < s.size() && s[i] == '.') {
+                ++i;
+                o.precision = 0;
+                if(i < s.size() && s[i] == '*') {
+                    o.dynamic_precision = true;
+                    ++i;
+                } else {
+                    for(; i < s.size() && is_digit(s[i]); ++i) {
+                        o.precision = o.precision*10 + (s[i]-'0');
+                    }
+                }
+            }
+            if(i+1 < s.size() && s[i] == 'h' && s[i+1] == 'h') {o.is_char = true; i += 2;}
+            else if(i+1 < s.size() && s[i] == 'l' && s[i+1] == 'l') {o.is_long_long = true; i += 2;}
+            else if(i < s.size() && s[i] == 'h') {o.is_short = true; ++i;}
+            else if(i < s.size() && (s[i] == 'l' || s[i] == 'j' || s[i] == 'z' || s[i] == 't')) {o.is_long = true; ++i;}
+            else if(i < s.size() && (s[i] == 'L' || s[i] == 'q')) {o.is_long_long = true; ++i;}
+
+            if(i < s.size()) o.spec = s[i];
+            return {o,i};
+        }
+
+        //Arguments consumed by the specs of a format string, '*' width and precision included
+        constexpr std::size_t argument_count(util::string_view s) {
+            std::size_t n = 0;
+            for(std::size_t i = 0; i < s.size(); ++i) {
+                if(s[i] != '%') continue;
+                if(i+1 < s.size() && s[i+1] == '%') {
+                    ++i;
+                    continue;
+                }
+                const auto parsed = parse_printf_options(s.remove_prefix(i));
+                n += 1+parsed.opts.dynamic_width+parsed.opts.dynamic_precision;
+                i += parsed.spec_index;
+            }
+            return n;
+        }
+
         template<int currentParam, typename StringF>
         constexpr auto parse_spec_dispatch(StringF fs, PrintfFmt) {
             constexpr auto s = fs();
+            constexpr auto parsed = parse_printf_options(s);
+            static_assert(parsed.spec_index < s.size(), "Incomplete format specifier");
+
+            //'*' arguments come before the value, width first
+            constexpr int widthParam = parsed.opts.dynamic_width ? currentParam : -1;
+            constexpr int precisionParam = parsed.opts.dynamic_precision ? currentParam+parsed.opts.dynamic_width : -1;
+            constexpr int valueParam = currentParam+parsed.opts.dynamic_width+parsed.opts.dynamic_precision;
 
             using namespace format_to_typecheck;
-            using FormatSpecT = FormatSpec<decltype(to_type(CharV<s[1]>{})), currentParam>;
+            using FormatSpecT = FormatSpec<decltype(to_type(CharV<s[parsed.spec_index]>{})), valueParam, widthParam, precisionParam>;
 
-            return Spec<FormatSpecT>{{.spec=s[1]},s.remove_prefix(2),currentParam+1};
+            return Spec<FormatSpecT>{parsed.opts,s.remove_prefix(parsed.spec_index+1),valueParam+1};
         }
 
         template<int currentParam, typename StringF, typename Mode>
@@ -298,6 +1106,18 @@ namespace constexpr_format {
         struct FormatString {
             std::array<util::string_view,sizeof...(FormatSpecs)+1> strings;
             std::array<FormatOptions,sizeof...(FormatSpecs)> options;
+
+            using specs = std::tuple<FormatSpecs...>;
+
+            //Compact copy of options, 8 specs per cache line
+            constexpr auto packed_options() const {
+                std::array<PackedFormatOptions,sizeof...(FormatSpecs)> packed{};
+                for(std::size_t i = 0; i < packed.size(); ++i) {
+                    packed[i] = PackedFormatOptions::pack(options[i]);
+                }
+                return packed;
+            }
+
             template<typename F>
             constexpr static auto apply(F f) {
                 return f(FormatSpecs{}...);
@@ -338,7 +1158,7 @@ namespace constexpr_format {
 
                 return detail::FormatResult_t<FormatSpecT,std::remove_cv_t<decltype(result)>>{
                     util::prepend(prefix,result.strings),
-                    util::prepend(FormatOptions{},result.options)
+                    util::prepend(spec.opts,result.options)
                 };
             }
         }
@@ -364,23 +1184,35 @@ namespace constexpr_format {
                 static constexpr bool value = true;
             };
 
-            template<typename FormatSpec, typename Tup>
-            constexpr bool check_format_conversion(FormatSpec,Tup t) {
+            template<typename Tup, int N>
+            constexpr bool check_dynamic_arg() {
+                if constexpr(N != -1) {
+                    constexpr bool check_result = std::is_integral_v<std::decay_t<std::tuple_element_t<N,Tup>>>;
+                    static_assert(check_result, "'*' width and precision arguments must be integral");
+                    return check_result;
+                } else {
+                    return true;
+                }
+            }
+
+            //Tup is only used for its element types, so runtime arguments can be checked the same way
+            template<typename Tup, typename FormatSpec>
+            constexpr bool check_format_conversion(FormatSpec) {
                 if constexpr(FormatSpec::num != -1) {
                     using T = typename FormatSpec::type;
-                    using U = std::decay_t<decltype(std::get<FormatSpec::num>(t))>;
+                    using U = std::decay_t<std::tuple_element_t<FormatSpec::num,Tup>>;
                     constexpr bool check_result = T::template check<U>();
                     static_assert(check_result, "Mismatched format types");
-                    return check_result;
+                    return check_result && check_dynamic_arg<Tup,FormatSpec::width_num>() && check_dynamic_arg<Tup,FormatSpec::precision_num>();
                 } else {
                     return true;
                 }
             }
 
-            template<typename F, typename Tup>
-            constexpr bool check_format(F,Tup t) {
+            template<typename Tup, typename F>
+            constexpr bool check_format(F) {
                 constexpr auto num_args = F::template apply([](auto... fs) {
-                    return ((fs.num != -1) + ... + 0);
+                    return (((fs.num != -1) + (fs.width_num != -1) + (fs.precision_num != -1)) + ... + 0);
                 });
                 constexpr auto tuple_size = std::tuple_size_v<Tup>;
                 static_assert(tuple_size <= num_args, "Too many arguments for format");
@@ -390,42 +1222,91 @@ namespace constexpr_format {
                     //Error case still gives reasonable type to reduce compilation error output
                     return false;
                 } else {
-                    return F::template apply([=](auto... formats) {
-                        return (check_format_conversion(formats,t) && ...);
+                    return F::template apply([](auto... formats) {
+                        return (check_format_conversion<Tup>(formats) && ...);
                     });
                 }
             }
 
+            //Value of a '*' argument, 0 if the spec doesn't have one
+            template<int N, typename Tup>
+            constexpr long long dynamic_arg(const Tup& t) {
+                if constexpr(N == -1) {
+                    return 0;
+                } else {
+                    return static_cast<long long>(std::get<N>(t));
+                }
+            }
+
+            template<typename StringF, typename LayoutF>
+            constexpr auto apply_layout(StringF body, std::size_t offset, LayoutF layoutf) {
+                constexpr auto l = layoutf();
+                util::static_string<l.total()> result{};
+                std::size_t i = 0;
+                for(std::size_t n = 0; n < l.left; ++n) result[i++] = ' ';
+                if(l.sign != '\0') result[i++] = l.sign;
+                for(std::size_t n = 0; n < l.zeros; ++n) result[i++] = '0';
+                for(std::size_t n = 0; n < l.body; ++n) result[i++] = body()[offset+n];
+                for(std::size_t n = 0; n < l.right; ++n) result[i++] = ' ';
+                return result;
+            }
+
+            template<typename T, int Precision, bool Group, typename ArgF>
+            constexpr auto arg_string(ArgF argf) {
+                if constexpr(uses_precision<T>::value && uses_grouping<T>::value) {
+                    return Format<T>::template get_string<Precision,Group>(argf);
+                } else if constexpr(uses_grouping<T>::value) {
+                    return Format<T>::template get_string<Group>(argf);
+                } else if constexpr(uses_precision<T>::value) {
+                    return Format<T>::template get_string<Precision>(argf);
+                } else {
+                    return Format<T>::get_string(argf);
+                }
+            }
+
+            //Formats spec I followed by the literal string after it
+            template<std::size_t I, typename FormatF, typename ArgTupF>
+            constexpr auto format_spec(FormatF format, ArgTupF argsf) {
+                constexpr auto f = format();
+                using FSpec = std::tuple_element_t<I,typename std::remove_cv_t<decltype(f)>::specs>;
+                constexpr auto suffix = f.strings[I+1];
+
+                //If the format doesn't consume a parameter, it has a num of -1
+                if constexpr(FSpec::num == -1) {
+                    return Format<typename FSpec::type>::get_string() + util::view_to_static([]{return suffix;});
+                } else {
+                    constexpr auto args = argsf();
+                    constexpr auto opts = format_parser::resolve_dynamic(f.options[I],
+                        dynamic_arg<FSpec::width_num>(args),dynamic_arg<FSpec::precision_num>(args));
+
+                    using T = std::decay_t<std::tuple_element_t<FSpec::num,std::remove_cv_t<decltype(args)>>>;
+                    constexpr auto str = arg_string<T,opts.precision,opts.group>([argsf]{return std::get<FSpec::num>(argsf());});
+
+                    //Numeric output has its sign split off so zero-padding goes in between
+                    constexpr bool numeric = is_numeric_format<T>::value;
+                    constexpr bool negative = numeric && str.size() > 0 && str[0] == '-';
+                    constexpr auto value_opts = format_parser::with_zero_pad(opts,zero_pads(std::get<FSpec::num>(args)));
+                    constexpr auto l = format_parser::layout(str.size()-negative,numeric,negative,
+                        uses_precision<T>::value ? format_parser::without_precision(value_opts) : value_opts);
+                    return apply_layout([]{return str;},negative,[]{return l;}) + util::view_to_static([]{return suffix;});
+                }
+            }
+
+            template<typename FormatF, typename ArgTupF, std::size_t... I>
+            constexpr auto format_specs(FormatF format, ArgTupF argsf, std::index_sequence<I...>) {
+                return (format_spec<I>(format,argsf) + ... + util::static_string<0>{});
+            }
+
             template<typename FormatF, typename ArgTupF>
             constexpr auto format_impl(FormatF format, ArgTupF argsf) {
                 constexpr auto f = format();
                 constexpr std::tuple args = argsf();
 
-                if constexpr(check_format(f,args)) {
+                if constexpr(check_format<std::remove_cv_t<decltype(args)>>(f)) {
                     constexpr auto prefix = f.strings[0];
                     constexpr auto init = util::view_to_static([]{return prefix;});
 
-                    constexpr auto intermediate_strings = std::apply([](auto first, auto... xs) {
-                        return std::array<util::string_view,sizeof...(xs)>{xs...};
-                    },f.strings);
-                    constexpr auto options = f.options;
-
-                    //Zip results of formatting with strings in-between
-                    constexpr auto getString = [](auto format) constexpr {
-                        //If the format doesn't consume a parameter, it has a num of -1
-                        if constexpr(decltype(format)::num == -1) {
-                            using type = typename decltype(format)::type;
-                            return Format<type>::get_string();
-                        } else {
-                            constexpr auto val = std::get<format.num>(args);
-                            return Format<std::decay_t<decltype(val)>>::template get_string([]{return val;});
-                        }
-                    };
-                    return init+f.template apply([=](auto... fs) {
-                        return util::constexpr_apply([=](auto... prefixes) {
-                            return ((getString(fs) + util::view_to_static(prefixes)) + ... + util::static_string<0>{});
-                        },[]{return intermediate_strings;});
-                    });
+                    return init+format_specs(format,argsf,std::make_index_sequence<f.options.size()>{});
                 } else {
                     //Error case still gives reasonable type to reduce compilation error output
                     return util::static_string<1>{{'\0'}};
@@ -444,8 +1325,321 @@ namespace constexpr_format {
         }
     }
 
+    //Format string parsed at compile time, arguments formatted at runtime
+    namespace format_runtime {
+
+        namespace detail {
+
+            template<typename StringOrFormatF>
+            constexpr auto get_format(StringOrFormatF format) {
+                if constexpr (std::is_convertible_v<decltype(format()),util::string_view>) {
+                    return format_parser::parse_format(format);
+                } else {
+                    return format();
+                }
+            }
+
+            inline char* fill(char* out, char c, std::size_t n) {
+                std::memset(out,c,n);
+                return out+n;
+            }
+
+            //Precision for formatters that consume it, a compile-time constant unless it comes from a '*' argument
+            template<std::size_t I, typename FormatF, typename ArgTup>
+            auto spec_precision(FormatF format, const ArgTup& args) {
+                constexpr auto f = get_format(format);
+                using FSpec = std::tuple_element_t<I,typename std::remove_cv_t<decltype(f)>::specs>;
+                if constexpr(f.options[I].dynamic_precision) {
+                    return format_parser::resolve_dynamic(f.options[I],0,format_string::detail::dynamic_arg<FSpec::precision_num>(args)).precision;
+                } else {
+                    return std::integral_constant<int,f.options[I].precision>{};
+                }
+            }
+
+            //Arguments after the value for formatters that consume the precision or the ' flag, in that order
+            template<std::size_t I, typename T, typename FormatF, typename ArgTup>
+            auto spec_extra(FormatF format, const ArgTup& args) {
+                constexpr auto f = get_format(format);
+                constexpr std::bool_constant<f.options[I].group> group{};
+                if constexpr(uses_precision<T>::value && uses_grouping<T>::value) {
+                    return std::tuple(spec_precision<I>(format,args),group);
+                } else if constexpr(uses_grouping<T>::value) {
+                    return std::tuple(group);
+                } else if constexpr(uses_precision<T>::value) {
+                    return std::tuple(spec_precision<I>(format,args));
+                } else {
+                    return std::tuple<>();
+                }
+            }
+
+            //Formatters with an expensive conversion set uses_prepare and provide prepare(v, extra...). Its result is passed
+            //to size() and write() in place of the value, so every argument is converted once per formatting call.
+            template<std::size_t I, typename FormatF, typename ArgTup>
+            auto spec_prepared(FormatF format, const ArgTup& args) {
+                constexpr auto f = get_format(format);
+                using FSpec = std::tuple_element_t<I,typename std::remove_cv_t<decltype(f)>::specs>;
+                if constexpr(FSpec::num != -1) {
+                    using T = typename FSpec::template arg_type<ArgTup>;
+                    if constexpr(uses_prepare<T>::value) {
+                        return std::apply([&](auto... extra) {
+                            return Format<T>::prepare(std::get<FSpec::num>(args),extra...);
+                        },spec_extra<I,T>(format,args));
+                    } else {
+                        return std::tuple<>();
+                    }
+                } else {
+                    return std::tuple<>();
+                }
+            }
+
+            template<typename FormatF, typename ArgTup, std::size_t... I>
+            auto specs_prepared(FormatF format, const ArgTup& args, std::index_sequence<I...>) {
+                return std::tuple<decltype(spec_prepared<I>(format,args))...>(spec_prepared<I>(format,args)...);
+            }
+
+            template<std::size_t I, typename FormatF, typename ArgTup, typename Prepared>
+            format_parser::FieldLayout spec_layout(FormatF format, const ArgTup& args, const Prepared& prepared) {
+                constexpr auto f = get_format(format);
+                using FSpec = std::tuple_element_t<I,typename std::remove_cv_t<decltype(f)>::specs>;
+                using format_string::detail::dynamic_arg;
+
+                const auto& arg = std::get<FSpec::num>(args);
+                using T = typename FSpec::template arg_type<ArgTup>;
+                constexpr auto static_opts = uses_precision<T>::value ? format_parser::without_precision(f.options[I]) : f.options[I];
+                constexpr bool numeric = is_numeric_format<T>::value;
+
+                bool negative = false;
+                if constexpr(numeric) negative = Format<T>::negative(arg);
+                std::size_t body;
+                if constexpr(uses_prepare<T>::value) {
+                    body = Format<T>::size(prepared);
+                } else {
+                    body = std::apply([&](auto... extra) {
+                        return Format<T>::size(arg,extra...);
+                    },spec_extra<I,T>(format,args));
+                }
+                if constexpr(static_opts.dynamic_width || (static_opts.dynamic_precision && !uses_precision<T>::value)) {
+                    const auto opts = format_parser::resolve_dynamic(static_opts,dynamic_arg<FSpec::width_num>(args),
+                        uses_precision<T>::value ? -1 : dynamic_arg<FSpec::precision_num>(args));
+                    return format_parser::layout(body,numeric,negative,format_parser::with_zero_pad(opts,zero_pads(arg)));
+                } else if constexpr(has_zero_pads<T>::value && static_opts.pad == '0') {
+                    return format_parser::layout(body,numeric,negative,format_parser::with_zero_pad(static_opts,zero_pads(arg)));
+                } else {
+                    return format_parser::layout(body,numeric,negative,static_opts);
+                }
+            }
+
+            template<std::size_t I, typename FormatF, typename ArgTup, typename Prepared>
+            std::size_t spec_size(FormatF format, const ArgTup& args, const Prepared& prepared) {
+                constexpr auto f = get_format(format);
+                using FSpec = std::tuple_element_t<I,typename std::remove_cv_t<decltype(f)>::specs>;
+                if constexpr(FSpec::num == -1) {
+                    return Format<typename FSpec::type>::get_string().size();
+                } else {
+                    return spec_layout<I>(format,args,prepared).total();
+                }
+            }
+
+            //Writes spec I followed by the literal string after it
+            template<std::size_t I, typename FormatF, typename ArgTup, typename Prepared>
+            char* write_spec(char* out, FormatF format, const ArgTup& args, const Prepared& prepared) {
+                constexpr auto f = get_format(format);
+                using FSpec = std::tuple_element_t<I,typename std::remove_cv_t<decltype(f)>::specs>;
+                if constexpr(FSpec::num == -1) {
+                    constexpr auto literal = Format<typename FSpec::type>::get_string();
+                    std::memcpy(out,literal.data(),literal.size());
+                    out += literal.size();
+                } else {
+                    const auto& arg = std::get<FSpec::num>(args);
+                    const auto l = spec_layout<I>(format,args,prepared);
+                    out = fill(out,' ',l.left);
+                    if(l.sign != '\0') *out++ = l.sign;
+                    out = fill(out,'0',l.zeros);
+                    using T = typename FSpec::template arg_type<ArgTup>;
+                    if constexpr(uses_prepare<T>::value) {
+                        out = Format<T>::write(out,prepared,l.body);
+                    } else {
+                        out = std::apply([&](auto... extra) {
+                            return Format<T>::write(out,arg,l.body,extra...);
+                        },spec_extra<I,T>(format,args));
+                    }
+                    out = fill(out,' ',l.right);
+                }
+                return util::copy(out,f.strings[I+1]);
+            }
+
+            template<typename T, typename SFINAE_Check=void>
+            struct has_max_size : std::false_type {};
+
+            template<typename T>
+            struct has_max_size<T,std::void_t<decltype(Format<T>::max_size)>> : std::true_type {};
+
+            template<typename ArgTup, std::size_t I, typename FormatString>
+            constexpr std::size_t max_spec_size(const FormatString& f) {
+                using FSpec = std::tuple_element_t<I,typename FormatString::specs>;
+                if constexpr(FSpec::num == -1) {
+                    return Format<typename FSpec::type>::get_string().size();
+                } else {
+                    using T = typename FSpec::template arg_type<ArgTup>;
+                    static_assert(has_max_size<T>::value, "Argument type has no maximum formatted size");
+                    static_assert(FSpec::width_num == -1 && FSpec::precision_num == -1, "Maximum formatted size needs static width and precision");
+                    constexpr bool numeric = is_numeric_format<T>::value;
+                    bool negative = false;
+                    if constexpr(numeric) negative = Format<T>::can_be_negative;
+                    return std::max(format_parser::layout(Format<T>::max_size,numeric,false,f.options[I]).total(),
+                        format_parser::layout(Format<T>::max_size,numeric,negative,f.options[I]).total());
+                }
+            }
+
+            template<typename ArgTup, typename FormatString, std::size_t... I>
+            constexpr std::size_t max_specs_size(const FormatString& f, std::index_sequence<I...>) {
+                return (max_spec_size<ArgTup,I>(f) + ... + 0);
+            }
+
+            template<typename FormatF, typename ArgTup, typename PreparedTup, std::size_t... I>
+            std::size_t specs_size([[maybe_unused]] FormatF format, const ArgTup& args, const PreparedTup& prepared, std::index_sequence<I...>) {
+                return (spec_size<I>(format,args,std::get<I>(prepared)) + ... + 0);
+            }
+
+            template<typename FormatF, typename ArgTup, typename PreparedTup, std::size_t... I>
+            char* write_specs(char* out, [[maybe_unused]] FormatF format, const ArgTup& args, const PreparedTup& prepared, std::index_sequence<I...>) {
+                ((out = write_spec<I>(out,format,args,std::get<I>(prepared))), ...);
+                return out;
+            }
+
+            template<typename FormatString>
+            constexpr std::size_t literal_size(const FormatString& f) {
+                return std::apply([](auto... strings) {
+                    return (strings.size() + ...);
+                },f.strings);
+            }
+
+            //Measures, then writes to reserve(size) with every argument converted once
+            template<typename StringOrFormatF, typename Reserve, typename... Args>
+            void format_reserved(StringOrFormatF format, Reserve reserve, const Args&... args) {
+                constexpr auto f = get_format(format);
+                if constexpr(format_string::detail::check_format<std::tuple<std::decay_t<Args>...>>(f)) {
+                    const auto all = std::forward_as_tuple(args...);
+                    constexpr auto specs = std::make_index_sequence<f.options.size()>{};
+                    const auto prepared = specs_prepared(format,all,specs);
+                    char* out = reserve(literal_size(f)+specs_size(format,all,prepared,specs));
+                    write_specs(util::copy(out,f.strings[0]),format,all,prepared,specs);
+                }
+            }
+
+        }
+
+        //Upper bound of formatted_size for any arguments of types Args, e.g. to size a buffer at compile time.
+        //Every argument's formatter needs a max_size, and width and precision can't come from arguments.
+        template<typename... Args, typename StringOrFormatF>
+        constexpr std::size_t max_formatted_size(StringOrFormatF format) {
+            constexpr auto f = detail::get_format(format);
+            using Tup = std::tuple<std::decay_t<Args>...>;
+            if constexpr(format_string::detail::check_format<Tup>(f)) {
+                return detail::literal_size(f) + detail::max_specs_size<Tup>(f,std::make_index_sequence<f.options.size()>{});
+            } else {
+                return 0;
+            }
+        }
+
+        //Exact number of characters format_to will write
+        template<typename StringOrFormatF, typename... Args>
+        std::size_t formatted_size(StringOrFormatF format, const Args&... args) {
+            constexpr auto f = detail::get_format(format);
+            if constexpr(format_string::detail::check_format<std::tuple<std::decay_t<Args>...>>(f)) {
+                const auto all = std::forward_as_tuple(args...);
+                constexpr auto specs = std::make_index_sequence<f.options.size()>{};
+                return detail::literal_size(f) + detail::specs_size(format,all,detail::specs_prepared(format,all,specs),specs);
+            } else {
+                return 0;
+            }
+        }
+
+        //Writes the formatted result to out, which must hold formatted_size(format,args...) chars.
+        //Returns the end of the written range, no '\0' is appended.
+        template<typename StringOrFormatF, typename... Args>
+        char* format_to(char* out, StringOrFormatF format, const Args&... args) {
+            constexpr auto f = detail::get_format(format);
+            if constexpr(format_string::detail::check_format<std::tuple<std::decay_t<Args>...>>(f)) {
+                const auto all = std::forward_as_tuple(args...);
+                constexpr auto specs = std::make_index_sequence<f.options.size()>{};
+                out = util::copy(out,f.strings[0]);
+                return detail::write_specs(out,format,all,detail::specs_prepared(format,all,specs),specs);
+            } else {
+                return out;
+            }
+        }
+
+        template<typename StringOrFormatF, typename... Args>
+        std::string to_string(StringOrFormatF format, const Args&... args) {
+            std::string result;
+            detail::format_reserved(format,[&](std::size_t n) {
+                result.resize(n);
+                return result.data();
+            },args...);
+            return result;
+        }
+
+        //Format and arguments captured for formatting later, nothing is formatted until it is written out.
+        //Lvalue arguments are held by reference, so the object must not outlive them.
+        template<typename StringOrFormatF, typename... Args>
+        class LazyFormat {
+            StringOrFormatF format;
+            std::tuple<Args...> args;
+        public:
+            constexpr LazyFormat(StringOrFormatF format, std::tuple<Args...> args) : format(format), args(std::move(args)) {};
+
+            std::size_t size() const {
+                return std::apply([&](const auto&... as) {
+                    return formatted_size(format,as...);
+                },args);
+            }
+
+            char* format_to(char* out) const {
+                return std::apply([&](const auto&... as) {
+                    return format_runtime::format_to(out,format,as...);
+                },args);
+            }
+
+            //Appends to a std::string-like buffer in place
+            template<typename String>
+            void append_to(String& s) const {
+                const auto old_size = s.size();
+                std::apply([&](const auto&... as) {
+                    detail::format_reserved(format,[&](std::size_t n) {
+                        s.resize(old_size+n);
+                        return s.data()+old_size;
+                    },as...);
+                },args);
+            }
+
+            std::string to_string() const {
+                std::string result;
+                append_to(result);
+                return result;
+            }
+
+            explicit operator std::string() const {
+                return to_string();
+            }
+        };
+
+        template<typename StringOrFormatF, typename... Args>
+        auto lazy_format(StringOrFormatF format, Args&&... args) {
+            //Check at the call site rather than wherever the result ends up being formatted
+            constexpr auto f = detail::get_format(format);
+            static_assert(format_string::detail::check_format<std::tuple<std::decay_t<Args>...>>(f));
+            return LazyFormat<StringOrFormatF,Args...>(format,std::tuple<Args...>(std::forward<Args>(args)...));
+        }
+    }
+
     using format_parser::parse_format;
     using format_string::format;
+    using format_runtime::format_to;
+    using format_runtime::formatted_size;
+    using format_runtime::max_formatted_size;
+    using format_runtime::to_string;
+    using format_runtime::lazy_format;
 
     namespace string_udl {
         constexpr auto operator""_sv (const char* c, std::size_t n) {
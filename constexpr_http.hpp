@@ -0,0 +1,271 @@
+#pragma once
+
+#include "constexpr_format.hpp"
+
+#include <array>
+#include <ctime>
+#include <vector>
+
+#include <sys/uio.h>
+
+//HTTP/1.1 response heads from a format string of the status line and header lines, separated by '\n' or "\r\n":
+//  http::Head head;
+//  head.assign([]{return "HTTP/1.1 200 OK\nServer: edge\nContent-Type: %s\nCache-Control: no-cache"_sv;}, body.size(), type);
+//  ::writev(fd, head.with_body(body.data(), body.size()).data(), 2);
+//At compile time the lines are rewritten into one format string: header lines without specs are moved up behind the
+//status line, so together they are a single literal segment, followed by the lines with specs, Content-Length and Date.
+//Content-Length is written by the integer formatter and Date is copied from a per-thread cache updated once a second,
+//so neither should be part of the format. Lines keep their relative order otherwise, which keeps the arguments in order,
+//and a line without specs stays in place if a line with specs before it has the same field name, e.g. two Set-Cookie.
+//%s values have CR, LF and NUL replaced by spaces as RFC 9110 allows, so an argument can't end a line or the head.
+namespace constexpr_format::http {
+
+    //String argument of the head, written with CR, LF and NUL as spaces
+    struct FieldValue {
+        util::string_view value;
+    };
+
+    namespace detail {
+        struct Line {
+            std::size_t begin = 0;
+            std::size_t size = 0;
+        };
+
+        constexpr std::size_t line_end(util::string_view s, std::size_t i) {
+            while(i < s.size() && s[i] != '\n') ++i;
+            return i;
+        }
+
+        //Line without its '\r', empty lines are skipped
+        constexpr Line trimmed(util::string_view s, std::size_t begin, std::size_t end) {
+            if(end > begin && s[end-1] == '\r') --end;
+            return {begin,end-begin};
+        }
+
+        constexpr std::size_t line_count(util::string_view s) {
+            std::size_t n = 0;
+            for(std::size_t i = 0; i < s.size();) {
+                const auto end = line_end(s,i);
+                n += trimmed(s,i,end).size > 0;
+                i = end+1;
+            }
+            return n;
+        }
+
+        template<std::size_t N>
+        constexpr std::array<Line,N> split_lines(util::string_view s) {
+            std::array<Line,N> lines{};
+            std::size_t n = 0;
+            for(std::size_t i = 0; i < s.size();) {
+                const auto end = line_end(s,i);
+                const auto line = trimmed(s,i,end);
+                if(line.size > 0) lines[n++] = line;
+                i = end+1;
+            }
+            return lines;
+        }
+
+        constexpr bool has_specs(util::string_view line) {
+            for(std::size_t i = 0; i < line.size(); ++i) {
+                if(line[i] != '%') continue;
+                if(i+1 < line.size() && line[i+1] == '%') {
+                    ++i;
+                } else {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        constexpr util::string_view field_name(util::string_view line) {
+            std::size_t n = 0;
+            while(n < line.size() && line[n] != ':') ++n;
+            return line.prefix(n);
+        }
+
+        constexpr char lower(char c) {
+            return c >= 'A' && c <= 'Z' ? static_cast<char>(c-'A'+'a') : c;
+        }
+
+        //Field names are case-insensitive
+        constexpr bool same_field(util::string_view a, util::string_view b) {
+            a = field_name(a);
+            b = field_name(b);
+            if(a.size() != b.size()) return false;
+            for(std::size_t i = 0; i < a.size(); ++i) {
+                if(lower(a[i]) != lower(b[i])) return false;
+            }
+            return true;
+        }
+
+        constexpr util::string_view trailer = "Content-Length: %d\r\nDate: %s\r\n\r\n";
+
+        template<std::size_t N>
+        constexpr std::size_t wire_size(const std::array<Line,N>& lines) {
+            std::size_t n = trailer.size();
+            for(const auto& l : lines) n += l.size+2;
+            return n;
+        }
+
+        template<typename HeadF>
+        constexpr auto make_wire(HeadF head) {
+            constexpr util::string_view s = head();
+            constexpr auto n = line_count(s);
+            static_assert(n > 0, "Response head needs a status line");
+            constexpr auto lines = split_lines<n>(s);
+            util::static_string<wire_size(lines)> wire{};
+
+            char* p = wire.data();
+            const auto line = [s](const Line& l) {return s.remove_prefix(l.begin).prefix(l.size);};
+            //Moved up behind the status line: no specs, and no line with specs of the same field before it
+            const auto hoisted = [&](std::size_t i) {
+                if(has_specs(line(lines[i]))) return false;
+                for(std::size_t j = 1; j < i; ++j) {
+                    if(has_specs(line(lines[j])) && same_field(line(lines[j]),line(lines[i]))) return false;
+                }
+                return true;
+            };
+            p = util::put(p,line(lines[0]));
+            p = util::put(p,"\r\n");
+            for(bool moved : {true,false}) {
+                for(std::size_t i = 1; i < n; ++i) {
+                    if(hoisted(i) != moved) continue;
+                    p = util::put(p,line(lines[i]));
+                    p = util::put(p,"\r\n");
+                }
+            }
+            const char* const end = p;
+            util::put(p,trailer);
+
+            //%s before the trailer becomes %H
+            for(std::size_t i = 0; i < static_cast<std::size_t>(end-wire.data()); ++i) {
+                if(wire[i] != '%') continue;
+                if(wire[i+1] == '%') {
+                    ++i;
+                    continue;
+                }
+                i += format_parser::parse_printf_options(util::string_view(wire).remove_prefix(i)).spec_index;
+                if(wire[i] == 's') wire[i] = 'H';
+            }
+            return wire;
+        }
+
+        template<typename A>
+        decltype(auto) field_argument(const A& a) {
+            if constexpr(util::is_string_like<std::decay_t<A>>::value) {
+                return FieldValue{util::to_view(a)};
+            } else {
+                return a;
+            }
+        }
+
+        //Writes t as an IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+        inline char* write_date(char* out, std::time_t t) {
+            constexpr char days[] = "SunMonTueWedThuFriSat";
+            constexpr char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+            std::tm tm{};
+            ::gmtime_r(&t,&tm);
+            out = util::copy(out,util::string_view(days+3*tm.tm_wday,3));
+            out = util::copy(out,", ");
+            out = util::write_digits(out,static_cast<unsigned>(tm.tm_mday),2);
+            *out++ = ' ';
+            out = util::copy(out,util::string_view(months+3*tm.tm_mon,3));
+            *out++ = ' ';
+            out = util::write_digits(out,static_cast<unsigned>(tm.tm_year+1900),4);
+            *out++ = ' ';
+            out = util::write_digits(out,static_cast<unsigned>(tm.tm_hour),2);
+            *out++ = ':';
+            out = util::write_digits(out,static_cast<unsigned>(tm.tm_min),2);
+            *out++ = ':';
+            out = util::write_digits(out,static_cast<unsigned>(tm.tm_sec),2);
+            return util::copy(out," GMT");
+        }
+    }
+
+    constexpr std::size_t date_size = 29;
+
+    //Date header value of the current second, formatted at most once a second per thread
+    inline util::string_view date() {
+        thread_local std::time_t second = -1;
+        thread_local char text[date_size];
+        const std::time_t now = std::time(nullptr);
+        if(now != second) {
+            detail::write_date(text,now);
+            second = now;
+        }
+        return {text,date_size};
+    }
+
+    //Format string the head is rewritten to, taking the format's arguments followed by Content-Length and Date
+    template<typename HeadF>
+    constexpr auto wire_format(HeadF head) {
+        return detail::make_wire(head);
+    }
+
+    namespace detail {
+        template<typename HeadF, typename F>
+        decltype(auto) with_wire(HeadF head, F f) {
+            static constexpr auto wire = make_wire(head);
+            return f([]{return util::string_view(wire);});
+        }
+    }
+
+    template<typename HeadF, typename... Args>
+    std::size_t head_size(HeadF head, std::size_t content_length, const Args&... args) {
+        return detail::with_wire(head,[&](auto wire) {
+            return format_runtime::formatted_size(wire,detail::field_argument(args)...,content_length,date());
+        });
+    }
+
+    //Writes the head including the blank line ending it to out, which must hold head_size(head,content_length,args...) chars
+    template<typename HeadF, typename... Args>
+    char* write_head(char* out, HeadF head, std::size_t content_length, const Args&... args) {
+        return detail::with_wire(head,[&](auto wire) {
+            return format_runtime::format_to(out,wire,detail::field_argument(args)...,content_length,date());
+        });
+    }
+
+    //Response head in a buffer reused from one response to the next
+    class Head {
+        std::vector<char> buffer;
+        std::size_t used = 0;
+    public:
+        template<typename HeadF, typename... Args>
+        void assign(HeadF head, std::size_t content_length, const Args&... args) {
+            used = head_size(head,content_length,args...);
+            if(buffer.size() < used) buffer.resize(used);
+            write_head(buffer.data(),head,content_length,args...);
+        }
+
+        util::string_view view() const {return {buffer.data(),used};}
+
+        //Head and body for writev
+        std::array<iovec,2> with_body(const void* body, std::size_t n) const {
+            return {{{const_cast<char*>(buffer.data()),used},{const_cast<void*>(body),n}}};
+        }
+    };
+
+}
+
+namespace constexpr_format {
+
+    template<>
+    struct Format<http::FieldValue> {
+        static std::size_t size(const http::FieldValue& v) {
+            return v.value.size();
+        }
+
+        static char* write(char* out, const http::FieldValue& v, std::size_t len) {
+            for(std::size_t i = 0; i < len; ++i) {
+                const char c = v.value[i];
+                out[i] = c == '\r' || c == '\n' || c == '\0' ? ' ' : c;
+            }
+            return out+len;
+        }
+    };
+
+    namespace format_to_typecheck {
+        auto to_type(CharV<'H'>) -> Id<http::FieldValue>;
+    }
+
+}
@@ -0,0 +1,256 @@
+#pragma once
+
+#include "constexpr_format.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+//Minimum level that gets compiled in, as the underlying value of constexpr_format::log::Level.
+//Defaults to everything in debug builds and info and up with NDEBUG.
+#ifndef CONSTEXPR_FORMAT_LOG_LEVEL
+#ifdef NDEBUG
+#define CONSTEXPR_FORMAT_LOG_LEVEL 2
+#else
+#define CONSTEXPR_FORMAT_LOG_LEVEL 0
+#endif
+#endif
+
+//Whether log call sites measure the time spent formatting and writing their messages
+#ifndef CONSTEXPR_FORMAT_LOG_SITE_TIMING
+#define CONSTEXPR_FORMAT_LOG_SITE_TIMING 1
+#endif
+
+namespace constexpr_format::log {
+
+    enum class Level : int {
+        trace,
+        debug,
+        info,
+        warning,
+        error,
+        fatal,
+        off
+    };
+
+    constexpr Level threshold = static_cast<Level>(CONSTEXPR_FORMAT_LOG_LEVEL);
+
+    template<Level L>
+    constexpr bool enabled = L >= threshold && L != Level::off;
+
+    using sink_t = void(*)(Level, const char*, std::size_t);
+
+    inline void stderr_sink(Level, const char* message, std::size_t n) {
+        std::fwrite(message,1,n,stderr);
+        std::fputc('\n',stderr);
+    }
+
+    //Loaded once per message, so it can be replaced while other threads log
+    inline std::atomic<sink_t> sink{stderr_sink};
+
+    inline void set_sink(sink_t s) {
+        sink.store(s,std::memory_order_release);
+    }
+
+    namespace detail {
+        //Sink object of class Sink that messages are forwarded to by install(). remove() waits for the calls
+        //already forwarded to it, so the object can be destroyed right after.
+        template<typename Sink>
+        struct Installed {
+            inline static std::atomic<Sink*> object{nullptr};
+            inline static std::atomic<std::uint32_t> calls{0};
+
+            //Counting the call before loading object lets remove() see every call that got the object
+            static void forward(Level level, const char* message, std::size_t n) {
+                calls.fetch_add(1);
+                if(Sink* s = object.load()) s->write(level,message,n);
+                calls.fetch_sub(1,std::memory_order_release);
+            }
+
+            static void install(Sink* s) {
+                object.store(s);
+                set_sink(forward);
+            }
+
+            //Sequentially consistent with forward(): either the call is counted here or it sees no object.
+            //The sink is only reset if no other sink was set since.
+            static void remove(Sink* s) {
+                if(!object.compare_exchange_strong(s,nullptr)) return;
+                sink_t installed = forward;
+                sink.compare_exchange_strong(installed,stderr_sink);
+                while(calls.load() != 0) std::this_thread::yield();
+            }
+        };
+    }
+
+    //Counters kept for every call site, each on its own cache line
+    struct alignas(64) Site {
+        std::atomic<std::uint64_t> hits{0};
+        std::atomic<std::uint64_t> bytes{0};
+        std::atomic<std::uint64_t> suppressed{0};
+        std::atomic<std::uint64_t> ns{0};
+        //Rate limiter state, see admit
+        std::atomic<std::int64_t> next_allowed{0};
+
+        //Filled in when the site is first hit, before it is added to the list of sites
+        std::atomic<bool> registered{false};
+        util::string_view format{"",0};
+        const char* file = "?";
+        int line = 0;
+        Level level = Level::off;
+        Site* next = nullptr;
+    };
+
+    //Every site that has been hit at least once, most recent first
+    inline std::atomic<Site*> sites{nullptr};
+
+    //The format lambda's type is unique to its call site, so it doubles as the site's identity
+    template<typename StringOrFormatF>
+    inline Site site{};
+
+    template<typename StringOrFormatF>
+    Site& site_of(StringOrFormatF) {
+        return site<StringOrFormatF>;
+    }
+
+    namespace detail {
+        //Messages up to this size are formatted on the stack
+        constexpr std::size_t stack_buffer_size = 512;
+
+        inline std::int64_t now_ns() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        template<typename StringOrFormatF>
+        void register_site(Site& s, Level level, StringOrFormatF format, const char* file, int line) {
+            if(s.registered.exchange(true,std::memory_order_relaxed)) return;
+            if constexpr(std::is_convertible_v<decltype(format()),util::string_view>) {
+                s.format = format();
+            }
+            if(file) s.file = file;
+            s.line = line;
+            s.level = level;
+            s.next = sites.load(std::memory_order_relaxed);
+            while(!sites.compare_exchange_weak(s.next,&s,std::memory_order_release,std::memory_order_relaxed)) {}
+        }
+    }
+
+    //Token bucket of Burst messages refilled at PerSecond, kept as a single timestamp (generic cell rate algorithm).
+    //Rejected calls are counted as hits and suppressed, accepted ones are counted by write.
+    template<std::int64_t PerSecond, std::int64_t Burst, typename StringOrFormatF>
+    bool admit(StringOrFormatF) {
+        static_assert(PerSecond > 0 && Burst > 0, "Rate limits must be positive");
+        constexpr std::int64_t interval = 1000000000/PerSecond;
+        auto& s = site<StringOrFormatF>;
+
+        const auto now = detail::now_ns();
+        auto tat = s.next_allowed.load(std::memory_order_relaxed);
+        for(;;) {
+            const auto next = std::max(tat,now)+interval;
+            if(next-now > Burst*interval) {
+                s.hits.fetch_add(1,std::memory_order_relaxed);
+                s.suppressed.fetch_add(1,std::memory_order_relaxed);
+                return false;
+            }
+            if(s.next_allowed.compare_exchange_weak(tat,next,std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+    }
+
+    //Arguments are still evaluated at the call site, use CONSTEXPR_FORMAT_LOG to avoid that for disabled levels
+    template<Level L, typename StringOrFormatF, typename... Args>
+    void write_at(const char* file, int line, StringOrFormatF format, const Args&... args) {
+        if constexpr(enabled<L>) {
+            auto& s = site<StringOrFormatF>;
+            if(!s.registered.load(std::memory_order_relaxed)) {
+                detail::register_site(s,L,format,file,line);
+            }
+            [[maybe_unused]] const auto start = CONSTEXPR_FORMAT_LOG_SITE_TIMING ? detail::now_ns() : 0;
+
+            char buffer[detail::stack_buffer_size];
+            std::string str;
+            char* message = buffer;
+            std::size_t n = 0;
+            format_runtime::detail::format_reserved(format,[&](std::size_t size) {
+                n = size;
+                if(n > detail::stack_buffer_size) {
+                    str.resize(n);
+                    message = str.data();
+                }
+                return message;
+            },args...);
+            s.hits.fetch_add(1,std::memory_order_relaxed);
+            s.bytes.fetch_add(n,std::memory_order_relaxed);
+            sink.load(std::memory_order_acquire)(L,message,n);
+
+            if constexpr(CONSTEXPR_FORMAT_LOG_SITE_TIMING) {
+                s.ns.fetch_add(detail::now_ns()-start,std::memory_order_relaxed);
+            }
+        }
+    }
+
+    template<Level L, typename StringOrFormatF, typename... Args>
+    void write(StringOrFormatF format, const Args&... args) {
+        write_at<L>(nullptr,0,format,args...);
+    }
+
+    //One line per site that has been hit, most expensive first
+    //The counters are copied first, sorting by values other threads keep changing wouldn't be a strict weak ordering
+    inline std::string stats_table() {
+        struct Row {
+            const Site* site;
+            std::uint64_t hits, suppressed, bytes, ns;
+        };
+        std::vector<Row> rows;
+        for(const Site* s = sites.load(std::memory_order_acquire); s; s = s->next) {
+            rows.push_back({s,s->hits.load(std::memory_order_relaxed),s->suppressed.load(std::memory_order_relaxed),
+                s->bytes.load(std::memory_order_relaxed),s->ns.load(std::memory_order_relaxed)});
+        }
+        std::sort(rows.begin(),rows.end(),[](const Row& a, const Row& b) {
+            return a.ns != b.ns ? a.ns > b.ns : a.bytes > b.bytes;
+        });
+
+        std::string table = to_string([]{return util::string_view("%12s %12s %12s %12s  %s\n");},"hits","suppressed","bytes","time_us","site");
+        for(const Row& r : rows) {
+            lazy_format([]{return util::string_view("%12d %12d %12d %12d  %s:%d \"%s\"\n");},
+                r.hits,r.suppressed,r.bytes,r.ns/1000,r.site->file,r.site->line,r.site->format).append_to(table);
+        }
+        return table;
+    }
+
+    inline void dump_stats(std::FILE* out = stderr) {
+        const auto table = stats_table();
+        std::fwrite(table.data(),1,table.size(),out);
+    }
+
+    inline void dump_stats_at_exit() {
+        std::atexit([]{dump_stats();});
+    }
+
+}
+
+//Disabled levels are discarded with if constexpr, so neither the arguments nor the format are ever evaluated or emitted.
+//level is one of the constexpr_format::log::Level names, format a string literal.
+#define CONSTEXPR_FORMAT_LOG(level, format, ...) \
+    do { \
+        if constexpr(::constexpr_format::log::enabled<::constexpr_format::log::Level::level>) { \
+            ::constexpr_format::log::write_at<::constexpr_format::log::Level::level>(__FILE__, __LINE__, \
+                []{return ::constexpr_format::util::string_view(format);}, ##__VA_ARGS__); \
+        } \
+    } while(0)
+
+//Like CONSTEXPR_FORMAT_LOG, but drops messages beyond burst at a sustained per_second rate.
+//The limit is checked before the arguments are evaluated.
+#define CONSTEXPR_FORMAT_LOG_LIMITED(level, per_second, burst, format, ...) \
+    do { \
+        if constexpr(::constexpr_format::log::enabled<::constexpr_format::log::Level::level>) { \
+            constexpr auto constexpr_format_log_format = []{return ::constexpr_format::util::string_view(format);}; \
+            if(::constexpr_format::log::admit<per_second,burst>(constexpr_format_log_format)) { \
+                ::constexpr_format::log::write_at<::constexpr_format::log::Level::level>(__FILE__, __LINE__, constexpr_format_log_format, ##__VA_ARGS__); \
+            } \
+        } \
+    } while(0)
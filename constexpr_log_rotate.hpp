@@ -0,0 +1,186 @@
+#pragma once
+
+#include "constexpr_log.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+//Log sink writing to numbered files of a fixed size, base.1, base.2, ... (POSIX).
+//Writers never wait for files to be created or allocated: a background thread creates and preallocates the next file ahead of time,
+//and the writer that fills the current file switches to it with a single pointer swap. The background thread then
+//closes the old file once the last writer is done with it and deletes files beyond the number to keep.
+//Offsets in the current file are reserved with an atomic add, so concurrent writers each pwrite their own range.
+//Writers register in the current epoch before loading the current file. To close a retired file, the background
+//thread starts a new epoch and waits for the writers of the previous one, after that none of them can hold the file.
+namespace constexpr_format::log {
+
+    class RotatingFileSink {
+        struct File {
+            int fd = -1;
+            std::uint64_t number = 0;
+            std::atomic<std::uint64_t> used{0};
+        };
+
+        std::string base;
+        std::uint64_t max_bytes;
+        std::uint64_t keep;
+
+        std::atomic<File*> current{nullptr};
+        std::atomic<File*> next{nullptr};
+        std::atomic<File*> retired{nullptr};
+        std::atomic<std::uint64_t> failures{0};
+        std::atomic_flag rotating = ATOMIC_FLAG_INIT;
+        std::atomic<std::uint64_t> epoch{0};
+        //Writers in an epoch, by its parity
+        std::atomic<std::uint32_t> writers[2] = {};
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping = false;
+        std::thread thread;
+
+        std::string path_of(std::uint64_t number) const {
+            return to_string([]{return util::string_view("%s.%d");},base,number);
+        }
+
+        File* open_file(std::uint64_t number) {
+            const auto path = path_of(number);
+            const int fd = ::open(path.c_str(),O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0644);
+            if(fd < 0) return nullptr;
+#if defined(__linux__)
+            //Allocates the blocks without changing the file size, so a file that isn't filled up has no trailing zeros
+            ::fallocate(fd,FALLOC_FL_KEEP_SIZE,0,static_cast<off_t>(max_bytes));
+#endif
+            auto* f = new File;
+            f->fd = fd;
+            f->number = number;
+            return f;
+        }
+
+        static void close_file(File* f) {
+            ::close(f->fd);
+            delete f;
+        }
+
+        //Returns the epoch the writer is registered in. Checking the epoch again after registering makes sure
+        //synchronize() can't have missed it.
+        std::uint64_t enter() {
+            for(;;) {
+                const auto e = epoch.load();
+                writers[e & 1].fetch_add(1);
+                if(epoch.load() == e) return e;
+                writers[e & 1].fetch_sub(1);
+            }
+        }
+
+        void leave(std::uint64_t e) {
+            writers[e & 1].fetch_sub(1,std::memory_order_release);
+        }
+
+        //Waits until every writer that could have loaded a file no longer current is done
+        void synchronize() {
+            const auto e = epoch.fetch_add(1);
+            while(writers[e & 1].load(std::memory_order_acquire) != 0) std::this_thread::yield();
+        }
+
+        //Background thread: keeps the next file ready and disposes of retired ones
+        void maintain() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(!stopping) {
+                lock.unlock();
+                if(File* old = retired.exchange(nullptr)) {
+                    const auto number = old->number;
+                    synchronize();
+                    close_file(old);
+                    if(number+1 > keep) ::unlink(path_of(number+1-keep).c_str());
+                }
+                if(next.load() == nullptr) {
+                    const auto number = current.load()->number+1;
+                    next.store(open_file(number));
+                }
+                lock.lock();
+                wake.wait_for(lock,std::chrono::milliseconds(100));
+            }
+        }
+
+        //Called by writers that reached the end of f, switches to the next file if it is ready.
+        //Until then they keep appending to f, so files can end up slightly larger than max_bytes.
+        void rotate(File* f) {
+            if(rotating.test_and_set(std::memory_order_acquire)) return;
+            File* n = next.load();
+            if(n != nullptr && retired.load() == nullptr && current.compare_exchange_strong(f,n)) {
+                next.store(nullptr);
+                retired.store(f);
+                wake.notify_one();
+            }
+            rotating.clear(std::memory_order_release);
+        }
+    public:
+        //Starts with base.1. keep is the number of most recent files left on disk.
+        RotatingFileSink(std::string base_path, std::uint64_t max_bytes, std::uint64_t keep = 8) :
+            base(std::move(base_path)), max_bytes(max_bytes), keep(std::max<std::uint64_t>(keep,1)) {
+            File* first = open_file(1);
+            if(first == nullptr) return;
+            current.store(first);
+            thread = std::thread([this]{maintain();});
+        }
+
+        RotatingFileSink(const RotatingFileSink&) = delete;
+        RotatingFileSink& operator=(const RotatingFileSink&) = delete;
+
+        ~RotatingFileSink() {
+            detail::Installed<RotatingFileSink>::remove(this);
+            if(!thread.joinable()) return;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_one();
+            thread.join();
+            for(auto* slot : {&retired,&current}) {
+                if(File* f = slot->exchange(nullptr)) close_file(f);
+            }
+            if(File* n = next.exchange(nullptr)) {
+                ::unlink(path_of(n->number).c_str());
+                close_file(n);
+            }
+        }
+
+        explicit operator bool() const {return current.load() != nullptr;}
+
+        void write(Level, const char* message, std::size_t n) {
+            const std::uint64_t record = n+1;
+            const auto e = enter();
+            if(File* f = current.load()) {
+                const auto offset = f->used.fetch_add(record);
+                iovec iov[2] = {{const_cast<char*>(message),n},{const_cast<char*>("\n"),1}};
+                if(::pwritev(f->fd,iov,2,static_cast<off_t>(offset)) != static_cast<ssize_t>(record)) {
+                    failures.fetch_add(1,std::memory_order_relaxed);
+                }
+                if(offset+record >= max_bytes) rotate(f);
+            }
+            leave(e);
+        }
+
+        //Routes log messages to this sink until it is destroyed
+        void install() {
+            detail::Installed<RotatingFileSink>::install(this);
+        }
+
+        //Number of the file currently written to
+        std::uint64_t file_number() const {
+            const File* f = current.load();
+            return f ? f->number : 0;
+        }
+
+        //Messages that could not be written
+        std::uint64_t failed() const {return failures.load(std::memory_order_relaxed);}
+    };
+
+}
@@ -0,0 +1,272 @@
+#pragma once
+
+#include "constexpr_log.hpp"
+
+#include <cerrno>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//Log sink sending messages to a collector over a Unix domain socket (POSIX).
+//Messages are newline terminated like on stderr and batched, so a system call carries many of them:
+//  SOCK_DGRAM:   messages are packed into datagrams of up to datagram_size bytes, never split across datagrams,
+//                and full datagrams are sent batch at a time with sendmmsg where available
+//  SOCK_STREAM:  messages are appended to a buffer of datagram_size*batch bytes, written out when full
+//A batch is also sent by a background thread once its oldest message is max_delay old, on flush and on destruction.
+namespace constexpr_format::log {
+
+    class SocketSink {
+        int fd = -1;
+        bool datagram = true;
+        std::size_t datagram_size;
+        std::size_t batch;
+        std::chrono::nanoseconds max_delay;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping = false;
+        std::thread timer;
+        std::vector<char> buffer;
+        //End of every full datagram in buffer, the one being filled ends at used
+        std::vector<std::size_t> ends;
+        std::size_t used = 0;
+        std::int64_t oldest_ns = 0;
+        std::atomic<std::uint64_t> failures{0};
+
+        void send_datagrams() {
+            std::size_t count = ends.size();
+            if(used > (ends.empty() ? 0 : ends.back())) ++count;
+            std::vector<iovec> iov(count);
+            std::size_t start = 0;
+            for(std::size_t i = 0; i < count; ++i) {
+                const auto end = i < ends.size() ? ends[i] : used;
+                iov[i] = {buffer.data()+start,end-start};
+                start = end;
+            }
+#if defined(__linux__)
+            std::vector<mmsghdr> messages(count);
+            for(std::size_t i = 0; i < count; ++i) {
+                messages[i].msg_hdr = msghdr{};
+                messages[i].msg_hdr.msg_iov = &iov[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+            }
+            for(std::size_t sent = 0; sent < count;) {
+                const int n = ::sendmmsg(fd,messages.data()+sent,static_cast<unsigned>(count-sent),0);
+                if(n <= 0) {
+                    if(n < 0 && errno == EINTR) continue;
+                    failures += count-sent;
+                    break;
+                }
+                sent += n;
+            }
+#else
+            for(auto& v : iov) {
+                msghdr m{};
+                m.msg_iov = &v;
+                m.msg_iovlen = 1;
+                while(::sendmsg(fd,&m,0) < 0) {
+                    if(errno != EINTR) {
+                        ++failures;
+                        break;
+                    }
+                }
+            }
+#endif
+        }
+
+        void send_stream() {
+            for(std::size_t sent = 0; sent < used;) {
+                const auto n = ::send(fd,buffer.data()+sent,used-sent,MSG_NOSIGNAL);
+                if(n < 0) {
+                    if(errno == EINTR) continue;
+                    ++failures;
+                    break;
+                }
+                sent += static_cast<std::size_t>(n);
+            }
+        }
+
+        void flush_locked() {
+            if(used == 0) return;
+            if(datagram) {
+                send_datagrams();
+            } else {
+                send_stream();
+            }
+            ends.clear();
+            used = 0;
+        }
+
+        //Ends the current datagram, sending the batch once it is complete
+        void close_datagram() {
+            ends.push_back(used);
+            if(ends.size() >= batch) flush_locked();
+        }
+
+        //Background thread: sends a batch once its oldest message reaches max_delay, writers only wake it for a new batch
+        void run_timer() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(!stopping) {
+                if(used == 0) {
+                    wake.wait(lock);
+                    continue;
+                }
+                const auto left = oldest_ns+max_delay.count()-detail::now_ns();
+                if(left <= 0) {
+                    flush_locked();
+                } else {
+                    wake.wait_for(lock,std::chrono::nanoseconds(left));
+                }
+            }
+        }
+
+        //Returns whether the message started a batch
+        bool append(const char* message, std::size_t n, std::int64_t now) {
+            const auto record = n+1;
+            if(datagram) {
+                const auto start = ends.empty() ? 0 : ends.back();
+                if(used > start && used-start+record > datagram_size) close_datagram();
+            } else if(used+record > buffer.size() && used > 0) {
+                flush_locked();
+            }
+            const bool first = used == 0;
+            if(first) oldest_ns = now;
+            if(used+record > buffer.size()) buffer.resize(used+record);
+            std::memcpy(buffer.data()+used,message,n);
+            buffer[used+n] = '\n';
+            used += record;
+            //Messages larger than a datagram are sent on their own
+            if(datagram && used-(ends.empty() ? 0 : ends.back()) >= datagram_size) close_datagram();
+            return first;
+        }
+    public:
+        //Takes ownership of a connected socket of either type
+        explicit SocketSink(int fd, std::size_t datagram_size = 16*1024, std::size_t batch = 32,
+                std::chrono::nanoseconds max_delay = std::chrono::milliseconds(100)) :
+            fd(fd), datagram_size(datagram_size), batch(std::max<std::size_t>(batch,1)), max_delay(max_delay) {
+            int type = 0;
+            socklen_t len = sizeof(type);
+            if(fd >= 0 && ::getsockopt(fd,SOL_SOCKET,SO_TYPE,&type,&len) == 0) datagram = type == SOCK_DGRAM;
+            buffer.resize(datagram_size*this->batch);
+            if(fd >= 0) timer = std::thread([this]{run_timer();});
+        }
+
+        //Connects to the socket at path, invalid on failure
+        static int connect(const char* path, int type = SOCK_DGRAM) {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if(std::strlen(path) >= sizeof(address.sun_path)) return -1;
+            std::strcpy(address.sun_path,path);
+            const int fd = ::socket(AF_UNIX,type|SOCK_CLOEXEC,0);
+            if(fd < 0) return -1;
+            if(::connect(fd,reinterpret_cast<const sockaddr*>(&address),sizeof(address)) != 0) {
+                ::close(fd);
+                return -1;
+            }
+            return fd;
+        }
+
+        SocketSink(const char* path, int type = SOCK_DGRAM) : SocketSink(connect(path,type)) {}
+
+        SocketSink(const SocketSink&) = delete;
+        SocketSink& operator=(const SocketSink&) = delete;
+
+        ~SocketSink() {
+            detail::Installed<SocketSink>::remove(this);
+            if(timer.joinable()) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                wake.notify_one();
+                timer.join();
+            }
+            flush();
+            if(fd >= 0) ::close(fd);
+        }
+
+        explicit operator bool() const {return fd >= 0;}
+
+        void write(Level, const char* message, std::size_t n) {
+            if(fd < 0) return;
+            const auto now = detail::now_ns();
+            std::lock_guard<std::mutex> lock(mutex);
+            if(append(message,n,now)) wake.notify_one();
+        }
+
+        void flush() {
+            std::lock_guard<std::mutex> lock(mutex);
+            flush_locked();
+        }
+
+        //Routes log messages to this sink until it is destroyed
+        void install() {
+            detail::Installed<SocketSink>::install(this);
+        }
+
+        //Datagrams or stream writes that could not be sent
+        std::uint64_t failed() const {return failures.load();}
+    };
+
+    //Collector side, log_collector.cpp is a program around these two.
+    //Socket bound to path, listening if it is a SOCK_STREAM one. A socket left at path is replaced. Invalid on failure.
+    inline int collector_socket(const char* path, int type = SOCK_DGRAM) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if(std::strlen(path) >= sizeof(address.sun_path)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        std::strcpy(address.sun_path,path);
+        ::unlink(path);
+        const int fd = ::socket(AF_UNIX,type|SOCK_CLOEXEC,0);
+        if(fd < 0) return -1;
+        if(::bind(fd,reinterpret_cast<const sockaddr*>(&address),sizeof(address)) != 0 || (type == SOCK_STREAM && ::listen(fd,16) != 0)) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    //Writes everything received on a collector socket to out until stop is set, reading accepted connections until they close
+    inline void collect(int fd, std::FILE* out, const std::atomic<bool>& stop) {
+        int type = SOCK_DGRAM;
+        socklen_t len = sizeof(type);
+        ::getsockopt(fd,SOL_SOCKET,SO_TYPE,&type,&len);
+        const bool stream = type == SOCK_STREAM;
+
+        std::vector<char> buffer(256*1024);
+        std::vector<pollfd> fds{{fd,POLLIN,0}};
+        while(!stop.load(std::memory_order_relaxed)) {
+            //Timeout to notice stop, signals interrupt the wait as well
+            if(::poll(fds.data(),fds.size(),100) < 0) {
+                if(errno == EINTR) continue;
+                break;
+            }
+            for(std::size_t i = 0; i < fds.size(); ++i) {
+                if(!(fds[i].revents & (POLLIN|POLLHUP))) continue;
+                if(stream && i == 0) {
+                    const int client = ::accept4(fd,nullptr,nullptr,SOCK_CLOEXEC);
+                    if(client >= 0) fds.push_back({client,POLLIN,0});
+                    continue;
+                }
+                const auto n = ::recv(fds[i].fd,buffer.data(),buffer.size(),0);
+                if(n > 0) {
+                    std::fwrite(buffer.data(),1,static_cast<std::size_t>(n),out);
+                    std::fflush(out);
+                } else if(stream && n == 0) {
+                    ::close(fds[i].fd);
+                    fds.erase(fds.begin()+i--);
+                }
+            }
+        }
+        for(std::size_t i = 1; i < fds.size(); ++i) ::close(fds[i].fd);
+    }
+
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+//Placement of large logging buffers (POSIX): huge pages to cut TLB misses, and the NUMA node of the allocating thread
+//so a writer doesn't pay for remote memory on multi-socket machines.
+//Everything is a hint, whatever the system doesn't support is skipped and the memory is still usable.
+namespace constexpr_format::memory {
+
+    enum class HugePages {
+        none,
+        //madvise(MADV_HUGEPAGE), honoured for anonymous and shared memory when transparent huge pages are set to madvise or always
+        transparent,
+        //MAP_HUGETLB from the reserved pool for anonymous memory, falling back to transparent
+        reserved
+    };
+
+    struct Placement {
+        HugePages huge_pages = HugePages::transparent;
+        //Prefer the NUMA node of the calling thread
+        bool local_node = true;
+    };
+
+    //What was actually applied
+    struct Applied {
+        bool reserved_huge_pages = false;
+        bool transparent_huge_pages = false;
+        int node = -1;
+    };
+
+    //NUMA node of the calling thread, -1 if unknown
+    inline int current_node() {
+#if defined(__linux__) && defined(SYS_getcpu)
+        unsigned cpu = 0, node = 0;
+        if(::syscall(SYS_getcpu,&cpu,&node,nullptr) == 0) return static_cast<int>(node);
+#endif
+        return -1;
+    }
+
+    //Applies the placement to the whole pages in [memory,memory+size), which should not have been touched yet:
+    //pages already present keep their node
+    inline Applied place(void* memory, std::size_t size, Placement p) {
+        Applied applied;
+        const auto page = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+        const auto start = (reinterpret_cast<std::uintptr_t>(memory)+page-1) & ~(page-1);
+        const auto end = (reinterpret_cast<std::uintptr_t>(memory)+size) & ~(page-1);
+        if(end <= start) return applied;
+        memory = reinterpret_cast<void*>(start);
+        size = end-start;
+#if defined(MADV_HUGEPAGE)
+        if(p.huge_pages != HugePages::none) {
+            applied.transparent_huge_pages = ::madvise(memory,size,MADV_HUGEPAGE) == 0;
+        }
+#endif
+#if defined(__linux__) && defined(SYS_mbind)
+        if(p.local_node) {
+            const int node = current_node();
+            if(node >= 0 && node < 64) {
+                //MPOL_PREFERRED falls back to other nodes instead of failing when the local one is full
+                constexpr int mpol_preferred = 1;
+                const unsigned long mask = 1ul << node;
+                if(::syscall(SYS_mbind,memory,size,mpol_preferred,&mask,64ul,0u) == 0) applied.node = node;
+            }
+        }
+#endif
+        return applied;
+    }
+
+    //Anonymous private mapping placed as requested, zero-filled
+    class Region {
+        void* memory = MAP_FAILED;
+        std::size_t length = 0;
+        Applied applied_placement;
+
+        constexpr static std::size_t huge_page_size = 2*1024*1024;
+    public:
+        Region() = default;
+
+        explicit Region(std::size_t size, Placement p = {}) {
+#if defined(MAP_HUGETLB)
+            if(p.huge_pages == HugePages::reserved) {
+                const auto rounded = (size+huge_page_size-1) & ~(huge_page_size-1);
+                memory = ::mmap(nullptr,rounded,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB,-1,0);
+                if(memory != MAP_FAILED) {
+                    length = rounded;
+                    applied_placement = place(memory,length,{HugePages::none,p.local_node});
+                    applied_placement.reserved_huge_pages = true;
+                    return;
+                }
+            }
+#endif
+            memory = ::mmap(nullptr,size,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+            if(memory == MAP_FAILED) return;
+            length = size;
+            applied_placement = place(memory,length,p);
+        }
+
+        Region(Region&& other) noexcept :
+            memory(std::exchange(other.memory,MAP_FAILED)), length(std::exchange(other.length,0)), applied_placement(other.applied_placement) {}
+
+        Region& operator=(Region&& other) noexcept {
+            std::swap(memory,other.memory);
+            std::swap(length,other.length);
+            std::swap(applied_placement,other.applied_placement);
+            return *this;
+        }
+
+        ~Region() {
+            if(memory != MAP_FAILED) ::munmap(memory,length);
+        }
+
+        explicit operator bool() const {return memory != MAP_FAILED;}
+
+        void* data() const {return memory;}
+        std::size_t size() const {return length;}
+        const Applied& applied() const {return applied_placement;}
+    };
+
+    //Bump allocator over a Region, for buffers that live as long as the arena
+    class Arena {
+        Region region;
+        std::size_t used = 0;
+    public:
+        explicit Arena(std::size_t size, Placement p = {}) : region(size,p) {}
+
+        //nullptr when the arena is exhausted
+        void* allocate(std::size_t n, std::size_t alignment = alignof(std::max_align_t)) {
+            if(!region) return nullptr;
+            const auto start = (used+alignment-1) & ~(alignment-1);
+            if(start+n > region.size()) return nullptr;
+            used = start+n;
+            return static_cast<char*>(region.data())+start;
+        }
+
+        std::size_t size() const {return used;}
+        std::size_t capacity() const {return region.size();}
+        const Applied& applied() const {return region.applied();}
+    };
+
+}
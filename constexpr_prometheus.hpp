@@ -0,0 +1,229 @@
+#pragma once
+
+#include "constexpr_format.hpp"
+#include "constexpr_float.hpp"
+
+#include <cmath>
+#include <string>
+
+//Prometheus text exposition format (version 0.0.4):
+//  prometheus::Exposition out;
+//  out.family<prometheus::Type::counter>([]{return "http_requests_total"_sv;}, []{return "Requests handled."_sv;});
+//  out.sample([]{return "http_requests_total{job=\"api\",method=\"%s\",code=\"%d\"}"_sv;}, count, method, code);
+//The # HELP and # TYPE lines of a family are rendered completely at compile time, help text escaping included.
+//A sample is a series template of the metric name and its labels, in which constant labels are literal text and
+//dynamic label values are specs, followed by the value. The template is turned into a format string at compile time,
+//%s label values are escaped at scrape time, integer values use the integer formatter and floating-point values the
+//shortest round-trip conversion, with NaN, +Inf and -Inf spelled as Prometheus expects.
+namespace constexpr_format {
+
+    namespace prometheus {
+        enum class Type {
+            counter,
+            gauge,
+            histogram,
+            summary,
+            untyped
+        };
+
+        //Label value, escaped as required inside the quotes: backslash, double quote and line feed
+        struct LabelValue {
+            util::string_view value;
+        };
+
+        //Floating-point sample value, converted once on construction
+        struct Value {
+            char chars[shortest::max_size];
+            std::size_t size;
+
+            explicit Value(double v) {
+                util::string_view s = "";
+                if(std::isnan(v)) s = "NaN";
+                else if(std::isinf(v)) s = v > 0 ? util::string_view("+Inf") : util::string_view("-Inf");
+                size = s.size() > 0 ? util::copy(chars,s)-chars : shortest::write(chars,v)-chars;
+            }
+        };
+
+        namespace detail {
+            constexpr util::string_view type_name(Type t) {
+                switch(t) {
+                    case Type::counter: return "counter";
+                    case Type::gauge: return "gauge";
+                    case Type::histogram: return "histogram";
+                    case Type::summary: return "summary";
+                    default: return "untyped";
+                }
+            }
+
+            //[a-zA-Z_:][a-zA-Z0-9_:]*
+            constexpr bool valid_name(util::string_view s) {
+                if(s.size() == 0) return false;
+                for(std::size_t i = 0; i < s.size(); ++i) {
+                    const char c = s[i];
+                    const bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':';
+                    if(!letter && !(i > 0 && c >= '0' && c <= '9')) return false;
+                }
+                return true;
+            }
+
+            //Help text escapes backslash and line feed
+            constexpr std::size_t escaped_help_size(util::string_view s) {
+                std::size_t n = s.size();
+                for(char c : s) n += c == '\\' || c == '\n';
+                return n;
+            }
+
+            constexpr char* put_escaped_help(char* out, util::string_view s) {
+                for(char c : s) {
+                    if(c == '\\' || c == '\n') {
+                        *out++ = '\\';
+                        c = c == '\n' ? 'n' : c;
+                    }
+                    *out++ = c;
+                }
+                return out;
+            }
+
+            template<Type T, typename NameF, typename HelpF>
+            constexpr auto make_header(NameF name, HelpF help) {
+                constexpr util::string_view n = name();
+                constexpr util::string_view h = help();
+                static_assert(valid_name(n), "Invalid metric name");
+                util::static_string<7+n.size()+1+escaped_help_size(h)+1+7+n.size()+1+type_name(T).size()+1> header{};
+                char* p = header.data();
+                p = util::put(p,"# HELP ");
+                p = util::put(p,n);
+                *p++ = ' ';
+                p = put_escaped_help(p,h);
+                p = util::put(p,"\n# TYPE ");
+                p = util::put(p,n);
+                *p++ = ' ';
+                p = util::put(p,type_name(T));
+                *p++ = '\n';
+                return header;
+            }
+
+            constexpr std::size_t name_size(util::string_view series) {
+                std::size_t n = 0;
+                while(n < series.size() && series[n] != '{') ++n;
+                return n;
+            }
+
+            //The series with its %s label values switched to %Q, then the value and a line feed
+            template<bool Integral, typename SeriesF>
+            constexpr auto make_sample(SeriesF series) {
+                constexpr util::string_view s = series();
+                static_assert(valid_name(s.prefix(name_size(s))), "Invalid metric name");
+                util::static_string<s.size()+4> sample{};
+                char* p = util::put(sample.data(),s);
+                for(std::size_t i = 0; i < s.size(); ++i) {
+                    if(s[i] != '%') continue;
+                    if(i+1 < s.size() && s[i+1] == '%') {
+                        ++i;
+                        continue;
+                    }
+                    i += format_parser::parse_printf_options(s.remove_prefix(i)).spec_index;
+                    if(s[i] == 's') sample[i] = 'Q';
+                }
+                util::put(p,Integral ? " %d\n" : " %V\n");
+                return sample;
+            }
+
+            template<typename A>
+            decltype(auto) label_argument(const A& a) {
+                if constexpr(util::is_string_like<std::decay_t<A>>::value) {
+                    return LabelValue{util::to_view(a)};
+                } else {
+                    return a;
+                }
+            }
+        }
+
+        //Rendered header of a family, e.g. for inspection in tests
+        template<Type T, typename NameF, typename HelpF>
+        constexpr auto header(NameF name, HelpF help) {
+            return detail::make_header<T>(name,help);
+        }
+
+        //Format string a series template is turned into for values of type V
+        template<typename V, typename SeriesF>
+        constexpr auto sample_format(SeriesF series) {
+            return detail::make_sample<std::is_integral_v<V>>(series);
+        }
+
+        //Text of one scrape, the buffer keeps its capacity across clear()
+        class Exposition {
+            std::string text;
+        public:
+            template<Type T, typename NameF, typename HelpF>
+            void family(NameF name, HelpF help) {
+                static constexpr auto h = detail::make_header<T>(name,help);
+                text.append(h.data(),h.size());
+            }
+
+            //The value, then the arguments of the specs in the series template
+            template<typename SeriesF, typename V, typename... Labels>
+            void sample(SeriesF series, V value, const Labels&... labels) {
+                static_assert(std::is_arithmetic_v<V> && !std::is_same_v<V,bool>, "Sample values are integers or floating-point");
+                static constexpr auto format = detail::make_sample<std::is_integral_v<V>>(series);
+                const auto formatf = []{return util::string_view(format);};
+                if constexpr(std::is_integral_v<V>) {
+                    format_runtime::lazy_format(formatf,detail::label_argument(labels)...,value).append_to(text);
+                } else {
+                    format_runtime::lazy_format(formatf,detail::label_argument(labels)...,Value(static_cast<double>(value))).append_to(text);
+                }
+            }
+
+            util::string_view view() const {return {text.data(),text.size()};}
+            const std::string& str() const {return text;}
+            void clear() {text.clear();}
+            void reserve(std::size_t n) {text.reserve(n);}
+        };
+    }
+
+    template<>
+    struct Format<prometheus::LabelValue> {
+        constexpr static bool escaped(char c) {
+            return c == '\\' || c == '"' || c == '\n';
+        }
+
+        static std::size_t size(const prometheus::LabelValue& v) {
+            std::size_t n = v.value.size();
+            for(char c : v.value) n += escaped(c);
+            return n;
+        }
+
+        //len is below size() when a precision cuts the value, possibly between a backslash and the escaped character
+        static char* write(char* out, const prometheus::LabelValue& v, std::size_t len) {
+            char* const end = out+len;
+            for(std::size_t i = 0; i < v.value.size() && out < end; ++i) {
+                char c = v.value[i];
+                if(escaped(c)) {
+                    *out++ = '\\';
+                    if(out == end) break;
+                    c = c == '\n' ? 'n' : c;
+                }
+                *out++ = c;
+            }
+            return end;
+        }
+    };
+
+    template<>
+    struct Format<prometheus::Value> {
+        static std::size_t size(const prometheus::Value& v) {
+            return v.size;
+        }
+
+        static char* write(char* out, const prometheus::Value& v, std::size_t len) {
+            std::memcpy(out,v.chars,len);
+            return out+len;
+        }
+    };
+
+    namespace format_to_typecheck {
+        auto to_type(CharV<'Q'>) -> Id<prometheus::LabelValue>;
+        auto to_type(CharV<'V'>) -> Id<prometheus::Value>;
+    }
+
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "constexpr_format.hpp"
+
+#include <string>
+
+//Redis RESP commands from a format string, one bulk string per space-separated word:
+//  resp::encode([]{return "SET user:%d:name %s"_sv;}, id, name)
+//gives "*3\r\n$3\r\nSET\r\n$<n>\r\nuser:<id>:name\r\n$<n>\r\n<name>\r\n". Arguments can contain spaces, each word stays one bulk string.
+//The command is rewritten at compile time into a single format string in which words without specs, the array header
+//and all separators are literal text with their lengths already filled in, and every word with specs gets a %d for its length.
+//At runtime only those words are measured, then the whole command is written in one pass by the format engine.
+namespace constexpr_format::resp {
+
+    namespace detail {
+        //A word of the command, or of the wire format once it is laid out
+        struct Word {
+            std::size_t begin = 0;
+            std::size_t size = 0;
+            std::size_t first_arg = 0;
+            std::size_t args = 0;
+        };
+
+        constexpr bool is_space(char c) {return c == ' ';}
+
+        constexpr std::size_t word_count(util::string_view s) {
+            std::size_t n = 0;
+            for(std::size_t i = 0; i < s.size(); ++i) {
+                n += !is_space(s[i]) && (i == 0 || is_space(s[i-1]));
+            }
+            return n;
+        }
+
+        //Length of a word without specs, with %% standing for one character
+        constexpr std::size_t literal_size(util::string_view w) {
+            std::size_t n = w.size();
+            for(std::size_t i = 0; i+1 < w.size(); ++i) {
+                if(w[i] == '%' && w[i+1] == '%') {
+                    --n;
+                    ++i;
+                }
+            }
+            return n;
+        }
+
+        template<std::size_t N>
+        constexpr std::array<Word,N> split(util::string_view s) {
+            std::array<Word,N> words{};
+            std::size_t n = 0, arg = 0;
+            for(std::size_t i = 0; i < s.size();) {
+                if(is_space(s[i])) {
+                    ++i;
+                    continue;
+                }
+                Word& w = words[n++];
+                w.begin = i;
+                while(i < s.size() && !is_space(s[i])) ++i;
+                w.size = i-w.begin;
+                w.first_arg = arg;
+                w.args = format_parser::argument_count(s.remove_prefix(w.begin).prefix(w.size));
+                arg += w.args;
+            }
+            return words;
+        }
+
+        template<std::size_t N>
+        constexpr std::size_t dynamic_count(const std::array<Word,N>& words) {
+            std::size_t n = 0;
+            for(const auto& w : words) n += w.args != 0;
+            return n;
+        }
+
+        template<std::size_t N>
+        constexpr std::size_t wire_size(util::string_view s, const std::array<Word,N>& words) {
+            std::size_t n = 1+util::count_digits(N)+2;
+            for(const auto& w : words) {
+                const std::size_t length = w.args == 0 ? util::count_digits(literal_size(s.remove_prefix(w.begin).prefix(w.size))) : 2;
+                n += 1+length+2+w.size+2;
+            }
+            return n;
+        }
+
+        template<std::size_t Dynamic, std::size_t Size>
+        struct Layout {
+            //Format string of the whole command
+            util::static_string<Size> wire;
+            //Where the words with specs are in wire, each one a format string of its own
+            std::array<Word,Dynamic> dynamic;
+            std::size_t args;
+        };
+
+        template<typename CommandF>
+        constexpr auto make_layout(CommandF command) {
+            constexpr util::string_view s = command();
+            constexpr auto n = word_count(s);
+            static_assert(n > 0, "Empty RESP command");
+            constexpr auto words = split<n>(s);
+            Layout<dynamic_count(words),wire_size(s,words)> l{};
+
+            char* const start = l.wire.data();
+            char* p = start;
+            *p++ = '*';
+            p = util::write_digits(p,n,util::count_digits(n));
+            p = util::put(p,"\r\n");
+            std::size_t k = 0;
+            for(const auto& w : words) {
+                const auto text = s.remove_prefix(w.begin).prefix(w.size);
+                *p++ = '$';
+                if(w.args == 0) {
+                    const auto length = literal_size(text);
+                    p = util::write_digits(p,length,util::count_digits(length));
+                } else {
+                    p = util::put(p,"%d");
+                }
+                p = util::put(p,"\r\n");
+                if(w.args != 0) l.dynamic[k++] = {static_cast<std::size_t>(p-start),w.size,w.first_arg,w.args};
+                p = util::put(p,text);
+                p = util::put(p,"\r\n");
+            }
+            l.args = words[n-1].first_arg+words[n-1].args;
+            return l;
+        }
+
+        //Length of word K followed by its arguments
+        template<std::size_t K, typename LayoutF, typename ArgTup>
+        auto word_arguments(LayoutF layoutf, const ArgTup& args) {
+            constexpr auto w = layoutf().dynamic[K];
+            const auto part = util::slice<w.first_arg>(args,std::make_index_sequence<w.args>{});
+            const auto wordf = [layoutf]{
+                return util::string_view(layoutf().wire).remove_prefix(layoutf().dynamic[K].begin).prefix(layoutf().dynamic[K].size);
+            };
+            const std::size_t size = std::apply([&](const auto&... as) {
+                return format_runtime::formatted_size(wordf,as...);
+            },part);
+            return std::tuple_cat(std::tuple<std::size_t>(size),part);
+        }
+
+        template<typename LayoutF, typename ArgTup, std::size_t... K>
+        auto wire_arguments([[maybe_unused]] LayoutF layoutf, const ArgTup& args, std::index_sequence<K...>) {
+            return std::tuple_cat(word_arguments<K>(layoutf,args)...);
+        }
+
+        //Calls f(wire format, arguments with the word lengths in front of each word's arguments)
+        template<typename CommandF, typename F, typename... Args>
+        decltype(auto) with_wire(CommandF command, F f, const Args&... args) {
+            static constexpr auto layout = make_layout(command);
+            static_assert(layout.args == sizeof...(Args), "Wrong number of arguments for RESP command");
+            const auto wire_args = wire_arguments([]() -> const auto& {return layout;},std::forward_as_tuple(args...),
+                std::make_index_sequence<layout.dynamic.size()>{});
+            return std::apply([&](const auto&... as) -> decltype(auto) {
+                return f([]{return util::string_view(layout.wire);},as...);
+            },wire_args);
+        }
+    }
+
+    //Format string the command is rewritten to, e.g. for inspection in tests
+    template<typename CommandF>
+    constexpr auto wire_format(CommandF command) {
+        return detail::make_layout(command).wire;
+    }
+
+    template<typename CommandF, typename... Args>
+    std::size_t encoded_size(CommandF command, const Args&... args) {
+        return detail::with_wire(command,[](auto wire, const auto&... as) {
+            return format_runtime::formatted_size(wire,as...);
+        },args...);
+    }
+
+    //Writes the command to out, which must hold encoded_size(command,args...) chars, and returns the end
+    template<typename CommandF, typename... Args>
+    char* encode_to(char* out, CommandF command, const Args&... args) {
+        return detail::with_wire(command,[out](auto wire, const auto&... as) {
+            return format_runtime::format_to(out,wire,as...);
+        },args...);
+    }
+
+    //Appends the command, e.g. to pipeline several into one write
+    template<typename String, typename CommandF, typename... Args>
+    void append_to(String& s, CommandF command, const Args&... args) {
+        detail::with_wire(command,[&s](auto wire, const auto&... as) {
+            format_runtime::lazy_format(wire,as...).append_to(s);
+        },args...);
+    }
+
+    template<typename CommandF, typename... Args>
+    std::string encode(CommandF command, const Args&... args) {
+        std::string result;
+        append_to(result,command,args...);
+        return result;
+    }
+
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "constexpr_format.hpp"
+#include "constexpr_float.hpp"
+
+#include <cerrno>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+//StatsD lines, name:value|type, with DogStatsD tags, name:value|type|#tags (POSIX for the batcher).
+//A line is a template of the metric name and optionally "|#" and its tags, e.g. "api.%s.requests|#env:prod,route:%s".
+//At compile time it becomes a single format string with the value and type spliced in after the name, so the
+//static parts of the name and tags are literal segments and only specs and the value are formatted at runtime.
+//The value is passed before the template's arguments. Integer values use the integer formatter, floating-point
+//values the shortest round-trip conversion. Tag values are written as they are, they must not contain '|', ',' or '\n'.
+namespace constexpr_format::statsd {
+
+    enum class Type {
+        counter,
+        gauge,
+        timer,
+        histogram,
+        set,
+        distribution
+    };
+
+    namespace detail {
+        constexpr util::string_view type_code(Type t) {
+            switch(t) {
+                case Type::counter: return "c";
+                case Type::gauge: return "g";
+                case Type::timer: return "ms";
+                case Type::histogram: return "h";
+                case Type::set: return "s";
+                default: return "d";
+            }
+        }
+
+        constexpr std::size_t tags_start(util::string_view s) {
+            for(std::size_t i = 0; i+1 < s.size(); ++i) {
+                if(s[i] == '|' && s[i+1] == '#') return i;
+            }
+            return s.size();
+        }
+
+        template<std::size_t Size>
+        struct Line {
+            util::static_string<Size> format;
+            //Arguments of the name, the value goes after them
+            std::size_t name_args;
+        };
+
+        template<Type T, typename LineF>
+        constexpr auto make_line(LineF line) {
+            constexpr util::string_view s = line();
+            constexpr auto split = tags_start(s);
+            constexpr auto code = type_code(T);
+            static_assert(split > 0, "Missing metric name");
+            Line<s.size()+4+code.size()> l{};
+            char* p = util::put(l.format.data(),s.prefix(split));
+            p = util::put(p,":%s|");
+            p = util::put(p,code);
+            util::put(p,s.remove_prefix(split));
+            l.name_args = format_parser::argument_count(s.prefix(split));
+            return l;
+        }
+
+        //Text of a value, held for the duration of the call that formats the line
+        struct ValueText {
+            char chars[std::max<std::size_t>(shortest::max_size,20)];
+            std::size_t size;
+
+            template<typename V>
+            explicit ValueText(V v) {
+                if constexpr(std::is_integral_v<V>) {
+                    char* p = chars;
+                    if(Format<V>::negative(v)) *p++ = '-';
+                    size = Format<V>::write(p,v,Format<V>::size(v))-chars;
+                } else {
+                    size = shortest::write(chars,static_cast<double>(v))-chars;
+                }
+            }
+
+            util::string_view view() const {return {chars,size};}
+        };
+
+        //Calls f(line format, arguments with the value spliced in after the name's)
+        template<Type T, typename LineF, typename F, typename V, typename... Args>
+        decltype(auto) with_line(LineF line, F f, V value, const Args&... args) {
+            static_assert(std::is_arithmetic_v<V> && !std::is_same_v<V,bool>, "Metric values are integers or floating-point");
+            static constexpr auto l = make_line<T>(line);
+            static_assert(l.name_args <= sizeof...(Args), "Too few arguments for metric line");
+            const ValueText text(value);
+            const auto all = std::forward_as_tuple(args...);
+            const auto spliced = std::tuple_cat(util::slice<0>(all,std::make_index_sequence<l.name_args>{}),std::make_tuple(text.view()),
+                util::slice<l.name_args>(all,std::make_index_sequence<sizeof...(Args)-l.name_args>{}));
+            return std::apply([&](const auto&... as) -> decltype(auto) {
+                return f([]{return util::string_view(l.format);},as...);
+            },spliced);
+        }
+    }
+
+    //Format string a line template is turned into, taking the value as a %s after the name's arguments
+    template<Type T, typename LineF>
+    constexpr auto line_format(LineF line) {
+        return detail::make_line<T>(line).format;
+    }
+
+    template<Type T, typename LineF, typename V, typename... Args>
+    std::string to_string(LineF line, V value, const Args&... args) {
+        return detail::with_line<T>(line,[](auto format, const auto&... as) {
+            return format_runtime::to_string(format,as...);
+        },value,args...);
+    }
+
+    //Packs lines into datagrams of up to packet_size bytes, separated by '\n', and sends each with a single send().
+    //1432 bytes keep a packet within a 1500 byte Ethernet MTU with room for IP and UDP headers, use 8932 for jumbo frames
+    //or larger sizes over loopback and Unix domain sockets. A line longer than packet_size is sent on its own.
+    class Batcher {
+        int fd;
+        std::size_t packet_size;
+        std::vector<char> buffer;
+        std::size_t used = 0;
+        std::uint64_t packets = 0;
+        std::uint64_t failures = 0;
+    public:
+        //Takes ownership of a connected datagram socket
+        explicit Batcher(int fd, std::size_t packet_size = 1432) : fd(fd), packet_size(packet_size), buffer(packet_size) {}
+
+        //Connected UDP socket for an IPv4 address, invalid on failure
+        static int connect(const char* address = "127.0.0.1", std::uint16_t port = 8125) {
+            sockaddr_in to{};
+            to.sin_family = AF_INET;
+            to.sin_port = htons(port);
+            if(::inet_pton(AF_INET,address,&to.sin_addr) != 1) return -1;
+            const int fd = ::socket(AF_INET,SOCK_DGRAM|SOCK_CLOEXEC,0);
+            if(fd < 0) return -1;
+            if(::connect(fd,reinterpret_cast<const sockaddr*>(&to),sizeof(to)) != 0) {
+                ::close(fd);
+                return -1;
+            }
+            return fd;
+        }
+
+        Batcher(const Batcher&) = delete;
+        Batcher& operator=(const Batcher&) = delete;
+
+        ~Batcher() {
+            flush();
+            if(fd >= 0) ::close(fd);
+        }
+
+        explicit operator bool() const {return fd >= 0;}
+
+        template<Type T, typename LineF, typename V, typename... Args>
+        void add(LineF line, V value, const Args&... args) {
+            detail::with_line<T>(line,[this](auto format, const auto&... as) {
+                const auto n = format_runtime::formatted_size(format,as...);
+                if(used > 0 && used+1+n > packet_size) flush();
+                if(used > 0) buffer[used++] = '\n';
+                if(used+n > buffer.size()) buffer.resize(used+n);
+                used = format_runtime::format_to(buffer.data()+used,format,as...)-buffer.data();
+                if(used >= packet_size) flush();
+            },value,args...);
+        }
+
+        void flush() {
+            if(used == 0) return;
+            if(fd >= 0) {
+                ssize_t sent;
+                do {
+                    sent = ::send(fd,buffer.data(),used,0);
+                } while(sent < 0 && errno == EINTR);
+                if(sent == static_cast<ssize_t>(used)) {
+                    ++packets;
+                } else {
+                    ++failures;
+                }
+            }
+            used = 0;
+        }
+
+        std::uint64_t sent() const {return packets;}
+        //Packets that could not be sent
+        std::uint64_t failed() const {return failures;}
+    };
+
+}
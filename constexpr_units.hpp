@@ -0,0 +1,204 @@
+#pragma once
+
+#include "constexpr_format.hpp"
+
+#include <chrono>
+
+//Human-readable sizes and durations, written straight into the output like any other argument:
+//  %B  units::Bytes, in B, KiB, MiB, GiB, TiB, PiB or EiB, e.g. "1.50 MiB"
+//  %D  std::chrono::duration, in ns, us, ms or s, e.g. "12.3 ms"
+//The unit is picked by summing comparisons against the unit thresholds, which compiles to flag arithmetic instead of branches.
+//The precision is the number of significant digits (3 by default, at most 9), rounded half to even. Values in the
+//smallest unit are printed as they are, and a value that rounds up to the next unit is printed in it, e.g. 1023.9 KiB as "1.00 MiB".
+namespace constexpr_format {
+
+    namespace units {
+        struct Bytes {
+            std::uint64_t count;
+        };
+
+        template<typename T>
+        struct is_duration : std::false_type {};
+
+        template<typename Rep, typename Period>
+        struct is_duration<std::chrono::duration<Rep,Period>> : std::true_type {};
+
+        namespace detail {
+            constexpr int default_significant = 3;
+            constexpr int max_significant = 9;
+
+            constexpr const char* byte_units[] = {"B","KiB","MiB","GiB","TiB","PiB","EiB"};
+            constexpr const char* duration_units[] = {"ns","us","ms","s"};
+
+            struct Text {
+                char chars[32] = {};
+                std::size_t size = 0;
+            };
+
+            constexpr int significant_digits(int precision) {
+                return precision < 0 ? default_significant : std::min(std::max(precision,1),max_significant);
+            }
+
+            //fixed with the given number of decimals, a space and the unit
+            constexpr Text compose(std::uint64_t fixed, int decimals, const char* unit) {
+                Text t;
+                const auto scale = util::pow10_table[decimals];
+                const auto integer = fixed/scale;
+                char* p = util::write_digits(t.chars,integer,util::count_digits(integer));
+                if(decimals > 0) {
+                    *p++ = '.';
+                    p = util::write_digits(p,fixed%scale,decimals);
+                }
+                *p++ = ' ';
+                while(*unit != '\0') *p++ = *unit++;
+                t.size = static_cast<std::size_t>(p-t.chars);
+                return t;
+            }
+
+            constexpr int decimals_for(std::uint64_t integer, int significant) {
+                return std::max(significant-static_cast<int>(util::count_digits(integer)),0);
+            }
+
+            //Rounding up into a new integer digit, e.g. 9.999 to 10.00, leaves one decimal too many. The value is then
+            //a power of ten, so dropping the decimal is exact.
+            constexpr void carry(std::uint64_t& fixed, int& decimals, int significant) {
+                if(decimals > 0 && fixed == util::pow10_table[significant]) {
+                    fixed /= 10;
+                    --decimals;
+                }
+            }
+
+            constexpr Text bytes(std::uint64_t v, int significant) {
+                int unit = 0;
+                for(int k = 1; k <= 6; ++k) unit += v >= (std::uint64_t(1) << 10*k);
+                if(unit == 0) return compose(v,0,byte_units[0]);
+
+                //The fraction is v's low bits over 2^shift, its decimals are generated exactly one at a time
+                const int shift = 10*unit;
+                const std::uint64_t mask = (std::uint64_t(1) << shift)-1;
+                const std::uint64_t integer = v >> shift;
+                int decimals = decimals_for(integer,significant);
+                std::uint64_t fixed = integer;
+                std::uint64_t rest = v & mask;
+                for(int i = 0; i < decimals; ++i) {
+                    rest *= 10;
+                    fixed = fixed*10+(rest >> shift);
+                    rest &= mask;
+                }
+                const std::uint64_t half = std::uint64_t(1) << (shift-1);
+                if(rest > half || (rest == half && (fixed & 1))) ++fixed;
+                carry(fixed,decimals,significant);
+                if(unit < 6 && fixed == 1024*util::pow10_table[decimals]) {
+                    return compose(util::pow10_table[significant-1],significant-1,byte_units[unit+1]);
+                }
+                return compose(fixed,decimals,byte_units[unit]);
+            }
+
+            constexpr Text duration(std::uint64_t ns, int significant) {
+                const int unit = (ns >= 1000)+(ns >= 1000000)+(ns >= 1000000000);
+                if(unit == 0) return compose(ns,0,duration_units[0]);
+
+                const int digits = 3*unit;
+                int decimals = decimals_for(ns/util::pow10_table[digits],significant);
+                std::uint64_t fixed = 0;
+                if(decimals >= digits) {
+                    fixed = ns*util::pow10_table[decimals-digits];
+                } else {
+                    const auto divisor = util::pow10_table[digits-decimals];
+                    fixed = ns/divisor;
+                    const auto rest = ns%divisor;
+                    if(rest > divisor/2 || (rest == divisor/2 && (fixed & 1))) ++fixed;
+                    carry(fixed,decimals,significant);
+                }
+                if(unit < 3 && fixed == 1000*util::pow10_table[decimals]) {
+                    return compose(util::pow10_table[significant-1],significant-1,duration_units[unit+1]);
+                }
+                return compose(fixed,decimals,duration_units[unit]);
+            }
+        }
+    }
+
+    template<>
+    struct Format<units::Bytes> {
+        //The precision is the number of significant digits
+        constexpr static bool uses_precision = true;
+
+        template<int Precision, typename BytesF>
+        constexpr static auto get_string(BytesF f) {
+            constexpr auto t = units::detail::bytes(f().count,units::detail::significant_digits(Precision));
+            return util::view_to_static<t.size>(util::string_view(t.chars,t.size));
+        }
+
+        template<typename Precision>
+        static std::size_t size(const units::Bytes& b, Precision p) {
+            return units::detail::bytes(b.count,units::detail::significant_digits(static_cast<int>(p))).size;
+        }
+
+        template<typename Precision>
+        static char* write(char* out, const units::Bytes& b, std::size_t len, Precision p) {
+            const auto t = units::detail::bytes(b.count,units::detail::significant_digits(static_cast<int>(p)));
+            std::memcpy(out,t.chars,len);
+            return out+len;
+        }
+    };
+
+    template<typename Rep, typename Period>
+    struct Format<std::chrono::duration<Rep,Period>> {
+        using Duration = std::chrono::duration<Rep,Period>;
+        constexpr static bool uses_precision = true;
+
+        //Nanoseconds overflow beyond about 292 years, longer durations are converted to seconds first.
+        //They have at least 10 integer digits, so their fraction is never among the significant digits.
+        constexpr static std::int64_t max_ns_seconds = 9000000000;
+
+        constexpr static std::uint64_t magnitude(std::int64_t v) {
+            return v < 0 ? std::uint64_t(0)-static_cast<std::uint64_t>(v) : static_cast<std::uint64_t>(v);
+        }
+
+        constexpr static units::detail::Text text(const Duration& d, int significant) {
+            using namespace std::chrono;
+            const auto s = duration_cast<duration<std::int64_t>>(d);
+            if(s.count() > -max_ns_seconds && s.count() < max_ns_seconds) {
+                return units::detail::duration(magnitude(duration_cast<duration<std::int64_t,std::nano>>(d).count()),significant);
+            }
+            auto seconds = magnitude(s.count());
+            const auto rest = magnitude(duration_cast<duration<std::int64_t,std::nano>>(d-s).count());
+            if(rest > 500000000 || (rest == 500000000 && (seconds & 1))) ++seconds;
+            return units::detail::compose(seconds,0,units::detail::duration_units[3]);
+        }
+
+        template<int Precision, typename DurationF>
+        constexpr static auto get_string(DurationF f) {
+            constexpr auto t = text(f(),units::detail::significant_digits(Precision));
+            constexpr auto body = util::view_to_static<t.size>(util::string_view(t.chars,t.size));
+            if constexpr(f().count() < 0) {
+                return util::static_string<1>{{'-'}}+body;
+            } else {
+                return body;
+            }
+        }
+
+        //Runtime, the sign is placed by the caller
+        static bool negative(const Duration& d) {
+            return d.count() < 0;
+        }
+
+        template<typename Precision>
+        static std::size_t size(const Duration& d, Precision p) {
+            return text(d,units::detail::significant_digits(static_cast<int>(p))).size;
+        }
+
+        template<typename Precision>
+        static char* write(char* out, const Duration& d, std::size_t len, Precision p) {
+            const auto t = text(d,units::detail::significant_digits(static_cast<int>(p)));
+            std::memcpy(out,t.chars,len);
+            return out+len;
+        }
+    };
+
+    namespace format_to_typecheck {
+        auto to_type(CharV<'B'>) -> Id<units::Bytes>;
+        auto to_type(CharV<'D'>) -> TypeCheck<units::is_duration>;
+    }
+
+}
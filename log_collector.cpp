@@ -0,0 +1,31 @@
+//Reference collector for constexpr_log_socket.hpp, writes everything received on a Unix domain socket to stdout.
+//Usage: log_collector <socket path> [dgram|stream]
+//Build: g++ -std=c++17 -O2 log_collector.cpp -o log_collector -pthread
+
+#include "constexpr_log_socket.hpp"
+
+#include <csignal>
+
+namespace {
+    std::atomic<bool> stop{false};
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        std::fprintf(stderr,"usage: %s <socket path> [dgram|stream]\n",argv[0]);
+        return 2;
+    }
+    const bool stream = argc > 2 && std::strcmp(argv[2],"stream") == 0;
+
+    const int fd = constexpr_format::log::collector_socket(argv[1],stream ? SOCK_STREAM : SOCK_DGRAM);
+    if(fd < 0) {
+        std::perror("log_collector");
+        return 1;
+    }
+    std::signal(SIGINT,[](int) {stop.store(true);});
+    std::signal(SIGTERM,[](int) {stop.store(true);});
+
+    constexpr_format::log::collect(fd,stdout,stop);
+    ::close(fd);
+    ::unlink(argv[1]);
+}
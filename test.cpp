@@ -1,7 +1,842 @@
 #include "constexpr_format.hpp"
+#include "constexpr_float.hpp"
+#include "constexpr_units.hpp"
+#include "constexpr_resp.hpp"
+#include "constexpr_http.hpp"
+#include "constexpr_prometheus.hpp"
+#include "constexpr_statsd.hpp"
+#include "constexpr_log.hpp"
+#include "constexpr_log_socket.hpp"
+#include "constexpr_log_rotate.hpp"
+#include "constexpr_binlog.hpp"
+#include "constexpr_binlog_ring.hpp"
+#include "constexpr_binlog_shm.hpp"
+
+#include <netinet/in.h>
+#include <sys/wait.h>
+
+#include <cassert>
+#include <map>
+#include <stdexcept>
 
 void test() {
     using namespace constexpr_format::string_udl;
     constexpr static auto s = constexpr_format::format([]{return "Hello %%%s%%, this is number %d and %d"_sv;}, []{return std::tuple{"USER"_sv,1,5};});
     static_assert(s == "Hello %USER%, this is number 1 and 5");
 }
+
+void test_packed_options() {
+    using namespace constexpr_format::format_parser;
+    constexpr FormatOptions o{.precision=3,.width=12,.pad='0',.is_long=true,.showsign=true,.spec='d'};
+    constexpr auto p = PackedFormatOptions::pack(o);
+    static_assert(sizeof(p) == 8);
+    constexpr auto u = p.unpack();
+    static_assert(u.precision == 3 && u.width == 12 && u.pad == '0' && u.is_long && u.showsign && !u.left && u.spec == 'd');
+    static_assert(PackedFormatOptions::pack(FormatOptions{}).unpack().precision == -1);
+    static_assert(PackedFormatOptions::fits(FormatOptions{.precision=65534,.width=65535,.spec='d'}));
+    static_assert(!PackedFormatOptions::fits(FormatOptions{.width=65536,.spec='d'}) && !PackedFormatOptions::fits(FormatOptions{.precision=65535,.spec='d'}));
+    static_assert(parse_printf_options(constexpr_format::util::string_view("%.65535d")).opts.precision == 65535);
+
+    using namespace constexpr_format::string_udl;
+    //Only packing is limited, formatting isn't
+    assert(constexpr_format::to_string([]{return "%70000d"_sv;},1).size() == 70000);
+    constexpr auto f = constexpr_format::parse_format([]{return "%d and %s"_sv;});
+    constexpr auto table = f.packed_options();
+    static_assert(table[0].spec == 'd' && table[1].spec == 's');
+}
+
+void test_null_terminated() {
+    using namespace constexpr_format::string_udl;
+    constexpr static auto s = constexpr_format::format([]{return "%d%%"_sv;}, []{return std::tuple{42};});
+    static_assert(s.size() == 3);
+    static_assert(s.c_str()[3] == '\0');
+    static_assert(s.getNullTerminatedString().size() == 4);
+}
+
+void test_string_types() {
+    using namespace constexpr_format::string_udl;
+    constexpr static auto s = constexpr_format::format([]{return "%s %s"_sv;}, []{return std::tuple{std::string_view("a"),"b"};});
+    static_assert(s == "a b");
+
+    const char* c = "c";
+    char array[] = "array";
+    const auto r = constexpr_format::to_string([]{return "%s|%s|%s|%s|%s|%d"_sv;}, std::string("str"), std::string_view("view"), c, array, "lit"_sv, -123);
+    assert(r == "str|view|c|array|lit|-123");
+    assert(constexpr_format::formatted_size([]{return "%d%%"_sv;}, 4000000000u) == 11);
+}
+
+void test_options() {
+    using namespace constexpr_format::string_udl;
+    constexpr static auto s = constexpr_format::format([]{return "[%5d][%-5d][%05d][%+d][%.3d][%*d][%.*s]"_sv;}, []{return std::tuple{42,-42,-42,7,5,-4,1,3,"abcdef"_sv};});
+    static_assert(s == "[   42][-42  ][-0042][+7][005][1   ][abc]");
+
+    const auto r = constexpr_format::to_string([]{return "[%*d][%-*.*s][%0*d]"_sv;}, 6, -42, 5, 2, std::string("abcdef"), 4, 7);
+    assert(r == "[   -42][ab   ][0007]");
+
+    //C strings are only read up to the precision, this buffer has no terminator
+    [[maybe_unused]] const char unterminated[4] = {'w','x','y','z'};
+    assert(constexpr_format::to_string([]{return "[%.4s][%-6.*s][%.9s][%s]"_sv;}, unterminated, 2, unterminated, "ab", "cd") == "[wxyz][wx    ][ab][cd]");
+    static_assert(constexpr_format::format([]{return "[%5.2s]"_sv;}, []{return std::tuple{"abc"};}) == "[   ab]");
+}
+
+void test_small_integers() {
+    using namespace constexpr_format::string_udl;
+    char expected[64];
+    for(int v = -128; v <= 255; ++v) {
+        const auto u8 = static_cast<std::uint8_t>(v);
+        const auto i8 = static_cast<std::int8_t>(v);
+        std::snprintf(expected,sizeof(expected),"%d %d [%5d]",u8,i8,i8);
+        assert(constexpr_format::to_string([]{return "%d %d [%5d]"_sv;},u8,i8,i8) == expected);
+    }
+    for(int v = 0; v <= 65535; v += 7) {
+        const auto u16 = static_cast<std::uint16_t>(v);
+        const auto i16 = static_cast<std::int16_t>(v);
+        std::snprintf(expected,sizeof(expected),"%d %d %07d",u16,i16,i16);
+        assert(constexpr_format::to_string([]{return "%d %d %07d"_sv;},u16,i16,i16) == expected);
+    }
+    assert(constexpr_format::to_string([]{return "%d %d"_sv;},std::uint16_t(65535),std::int16_t(-32768)) == "65535 -32768");
+}
+
+void test_ranged() {
+    using namespace constexpr_format;
+    using namespace constexpr_format::string_udl;
+    constexpr static auto s = format([]{return "%02d:%d%%"_sv;}, []{return std::tuple{in_range<0,23>(7),in_range<0,100>(100)};});
+    static_assert(s == "07:100%");
+
+    char expected[64];
+    for(int v = -50; v <= 50; ++v) {
+        std::snprintf(expected,sizeof(expected),"[%d|%4d|%+.3d]",v,v,v);
+        [[maybe_unused]] const auto r = in_range<-50,50>(v);
+        assert(to_string([]{return "[%d|%4d|%+.3d]"_sv;},r,r,r) == expected);
+    }
+    assert(to_string([]{return "%d"_sv;},in_range<0,65535>(std::uint32_t(8080))) == "8080");
+
+    static_assert(max_formatted_size<Ranged<int,0,23>,Ranged<int,0,59>>([]{return "%02d:%02d"_sv;}) == 5);
+    static_assert(max_formatted_size<Ranged<int,-50,50>>([]{return "%d%%"_sv;}) == 4);
+    static_assert(max_formatted_size<std::uint16_t,int>([]{return "port %d pid %d"_sv;}) == 10+5+11);
+
+    binlog::MemoryOutput out;
+    binlog::Writer writer(out);
+    CONSTEXPR_FORMAT_BINLOG(writer, "hour %d", in_range<0,23>(5));
+    assert(binlog::decode_to_text(out.data(),out.size()).find("hour 5\n") != std::string::npos);
+}
+
+void test_fixed_float() {
+    using namespace constexpr_format::string_udl;
+    constexpr static auto s = constexpr_format::format([]{return "[%.2f][%8.3f][%-7.1f][%f][%+.0f][%06.2f]"_sv;}, []{return std::tuple{3.14159,-2.5,0.05,1.0/3,2.5,-1.005};});
+    static_assert(s == "[3.14][  -2.500][0.1    ][0.333333][+2][-01.00]");
+    static_assert(constexpr_format::format([]{return "%.1f %.1f"_sv;}, []{return std::tuple{0.0,-0.0f};}) == "0.0 -0.0");
+
+    char expected[1024];
+    const double values[] = {0.125, 1.005, -0.0, 2.675, 999.9999, 123456.785, 1e17, -1e-7, 4503599627370497.0, 1e300};
+    for(double v : values) {
+        for(int p = 0; p <= 12; p += 3) {
+            std::snprintf(expected,sizeof(expected),"%.*f|%.2f|%10.3f",p,v,v,v);
+            assert(constexpr_format::to_string([]{return "%.*f|%.2f|%10.3f"_sv;},p,v,v,v) == expected);
+        }
+    }
+    std::snprintf(expected,sizeof(expected),"%.30f|%12.20f|%.3f",0.1,-2.5,1e300);
+    std::string appended = "x";
+    constexpr_format::lazy_format([]{return "%.30f|%12.20f|%.3f"_sv;},0.1,-2.5,1e300).append_to(appended);
+    assert(appended == std::string("x")+expected);
+    assert(constexpr_format::to_string([]{return "%f %5.1f"_sv;},std::numeric_limits<double>::infinity(),-std::numeric_limits<float>::quiet_NaN()) == "inf  -nan");
+    assert(constexpr_format::to_string([]{return "%06f|%0*.1f|%06.1f"_sv;},-std::numeric_limits<double>::infinity(),5,
+        std::numeric_limits<double>::quiet_NaN(),2.5) == "  -inf|  nan|0002.5");
+    static_assert(constexpr_format::format([]{return "%+06.1f"_sv;}, []{return std::tuple{std::numeric_limits<double>::infinity()};}) == "  +inf");
+}
+
+void test_decimal() {
+    using namespace constexpr_format;
+    using namespace constexpr_format::string_udl;
+    using Money = Decimal<std::int64_t,2>;
+    constexpr static auto s = format([]{return "[%f][%'f][%.1f][%.4f][%'12.0f][%+f]"_sv;},
+        []{return std::tuple{Money{-123456789},Money{123456789},Money{25},Decimal<int,3>{-5},Money{99950},Money{7}};});
+    static_assert(s == "[-1234567.89][1,234,567.89][0.2][-0.0050][       1,000][+0.07]");
+
+    assert(to_string([]{return "%'f|%'.0f|%010.3f|%.*f"_sv;},Money{-100000},Money{-150},Money{-123},1,Money{35}) == "-1,000.00|-2|-00001.230|0.4");
+    assert(to_string([]{return "%'f %f"_sv;},Decimal<std::int64_t,0>{std::numeric_limits<std::int64_t>::min()},Decimal<std::uint8_t,2>{255})
+        == "-9,223,372,036,854,775,808 2.55");
+    char expected[64];
+    for(std::int64_t units = -2000; units <= 2000; units += 7) {
+        for(int p = 0; p <= 4; ++p) {
+            //Exact in binary at these magnitudes only when the fraction is a multiple of 1/4, otherwise compare unrounded
+            if(p < 2 && units % 25 != 0) continue;
+            std::snprintf(expected,sizeof(expected),"%.*f",p,units/100.0);
+            assert(to_string([]{return "%.*f"_sv;},p,Money{units}) == expected);
+        }
+    }
+}
+
+void test_units() {
+    using namespace constexpr_format;
+    using namespace constexpr_format::string_udl;
+    using namespace std::chrono_literals;
+    constexpr static auto s = format([]{return "%B|%.4B|%8B|%D|%.2D|%-9D|"_sv;},
+        []{return std::tuple{units::Bytes{1536},units::Bytes{10*1024*1024+1},units::Bytes{1000},std::chrono::microseconds(-2500),1999ns,12s};});
+    static_assert(s == "1.50 KiB|10.00 MiB|  1000 B|-2.50 ms|2.0 us|12.0 s   |");
+
+    const std::pair<std::uint64_t,const char*> sizes[] = {
+        {0,"0 B"}, {1023,"1023 B"}, {1024,"1.00 KiB"}, {1029,"1.00 KiB"}, {1030,"1.01 KiB"}, {1048575,"1.00 MiB"},
+        {123456789,"118 MiB"}, {std::uint64_t(3) << 40,"3.00 TiB"}, {~std::uint64_t(0),"16.0 EiB"},
+        {10234,"9.99 KiB"}, {10239,"10.0 KiB"}, {102399,"100 KiB"}, {1048063,"1023 KiB"}};
+    for([[maybe_unused]] const auto& [bytes,text] : sizes) {
+        assert(to_string([]{return "%B"_sv;},units::Bytes{bytes}) == text);
+    }
+    assert(to_string([]{return "%.1B %.*B"_sv;},units::Bytes{1536},5,units::Bytes{1536}) == "2 KiB 1.5000 KiB");
+
+    assert(to_string([]{return "%D %D %D %D %D"_sv;},999ns,1500ns,999999ns,-1250us,2min) == "999 ns 1.50 us 1.00 ms -1.25 ms 120 s");
+    assert(to_string([]{return "%D|%D|%D|%D|%.4D"_sv;},9996ns,99999ns,9999999ns,99949ns,99999ns) == "10.0 us|100 us|10.0 ms|99.9 us|100.0 us");
+    assert(to_string([]{return "[%+D][%6.1D]"_sv;},std::chrono::duration<double>(0.0125),3ms) == "[+12.5 ms][  3 ms]");
+
+    //Beyond the range of nanoseconds, from about 292 years on
+    assert(to_string([]{return "%D|%D|%D"_sv;},std::chrono::hours(24*365*1000),-std::chrono::milliseconds(10000000000001500),
+        std::chrono::seconds(8999999999)) == "31536000000 s|-10000000000002 s|8999999999 s");
+    static_assert(format([]{return "%D"_sv;}, []{return std::tuple{-std::chrono::hours(24*365*1000)};}) == "-31536000000 s");
+}
+
+void test_shortest_batch() {
+    using namespace constexpr_format;
+    std::vector<double> values = {0, -0.0, 1, -7, 1000, 12000, 100000, 1e6, 123456789, 1e15, 9007199254740993.0, 1e22, 0.1, -2.5,
+        1.0/3, 5e-324, 1.7976931348623157e308, std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+    for(int i = 0; i < 1000; ++i) {
+        values.push_back(i*1000.0);
+        values.push_back(i/7.0);
+    }
+    const shortest::Batch batch(values);
+    assert(batch.size() == values.size());
+    char expected[shortest::max_size];
+    for(std::size_t i = 0; i < values.size(); ++i) {
+        [[maybe_unused]] const auto end = std::to_chars(expected,expected+sizeof(expected),values[i]).ptr;
+        assert(batch[i] == util::string_view(expected,end-expected));
+    }
+    assert(batch[7] == "1e+06" && batch[0] == "0" && batch[1] == "-0");
+}
+
+void test_lazy() {
+    using namespace constexpr_format::string_udl;
+    int n = 1;
+    const auto lazy = constexpr_format::lazy_format([]{return "%s=%d"_sv;}, std::string("n"), n);
+    n = 2;
+    assert(lazy.to_string() == "n=2");
+
+    std::string log = "> ";
+    lazy.append_to(log);
+    assert(log == "> n=2");
+}
+
+std::string last_log;
+
+void test_log_levels() {
+    using namespace constexpr_format;
+    static_assert(!log::enabled<log::Level::off>);
+    static_assert(log::enabled<log::Level::fatal>);
+
+    log::set_sink([](log::Level, const char* message, std::size_t n) {last_log.assign(message,n);});
+    int evaluated = 0;
+    CONSTEXPR_FORMAT_LOG(error, "%s failed %d times", "open", ++evaluated);
+    assert(last_log == "open failed 1 times");
+    CONSTEXPR_FORMAT_LOG(off, "%d", ++evaluated);
+    assert(evaluated == 1);
+
+    for(int i = 0; i < 5; ++i) {
+        CONSTEXPR_FORMAT_LOG_LIMITED(error, 1, 2, "flood %d", ++evaluated);
+    }
+    assert(evaluated == 3 && last_log == "flood 3");
+
+    constexpr auto site_format = []{return util::string_view("site %d");};
+    for(int i = 0; i < 4; ++i) {
+        if(log::admit<1,3>(site_format)) log::write<log::Level::error>(site_format,i);
+    }
+    [[maybe_unused]] const auto& site = log::site_of(site_format);
+    assert(site.hits == 4 && site.suppressed == 1 && site.bytes == 18);
+    log::set_sink(log::stderr_sink);
+
+    const auto table = log::stats_table();
+    assert(table.find("test.cpp:") != std::string::npos);
+    assert(table.find("\"site %d\"") != std::string::npos);
+}
+
+void test_binlog() {
+    using namespace constexpr_format;
+    binlog::MemoryOutput out;
+    binlog::Calibration calibration{1e9,0,951782400000000000};
+    binlog::Writer writer(out,calibration);
+    CONSTEXPR_FORMAT_BINLOG(writer, "%s=%05d", "x", -42);
+    CONSTEXPR_FORMAT_BINLOG(writer, "%-*s|", 4, std::string("ab"));
+    for(long long i = -1; i <= 1; ++i) {
+        CONSTEXPR_FORMAT_BINLOG(writer, "%d %d", binlog::delta(1000000000000+i), i);
+    }
+    static_assert(binlog::detail::type_code<Ranged<int,-5,5>>() == 'i' && binlog::detail::type_code<binlog::Delta<int>>() == 'I');
+    CONSTEXPR_FORMAT_BINLOG(writer, "%d", in_range<-5,5>(-3));
+
+    std::vector<std::string> messages;
+    [[maybe_unused]] const bool decoded = binlog::decode(out.data(),out.size(),[&]([[maybe_unused]] binlog::WallClock time, util::string_view, int, const std::string& m) {
+        assert(time.ns >= calibration.ref_unix_ns);
+        messages.push_back(m);
+    });
+    assert(decoded);
+    assert(messages.size() == 6 && messages[0] == "x=-0042" && messages[1] == "ab  |" && messages[5] == "-3");
+    assert(messages[2] == "999999999999 -1" && messages[4] == "1000000000001 1");
+
+    //A definition with an id far beyond the others fails the decode instead of allocating for it
+    std::string corrupt(out.data(),sizeof(binlog::detail::header_magic)+sizeof(binlog::Calibration));
+    corrupt += std::string("D\xf0\xff\xff\xff",5) + std::string(9,'\0');
+    assert(!binlog::decode(corrupt.data(),corrupt.size(),[](binlog::WallClock, util::string_view, int, const std::string&) {}));
+    assert(to_string([]{return util::string_view("%T");},binlog::WallClock{951782400123456789}) == "2000-02-29 00:00:00.123456789");
+}
+
+void test_binlog_ring() {
+    using namespace constexpr_format;
+    const char* path = "/tmp/constexpr_format_test_ring";
+    {
+        binlog::MappedRing ring(path,512);
+        assert(ring);
+        binlog::Writer writer(ring);
+        for(int i = 0; i < 100; ++i) {
+            CONSTEXPR_FORMAT_BINLOG(writer, "message %d", i);
+        }
+    }
+    const auto stream = binlog::recover(path);
+    std::vector<std::string> messages;
+    [[maybe_unused]] const bool decoded = binlog::decode(stream.data(),stream.size(),[&](binlog::WallClock, util::string_view, int, const std::string& m) {
+        messages.push_back(m);
+    });
+    assert(decoded);
+    assert(messages.size() > 10 && messages.size() < 100 && messages.back() == "message 99");
+
+    //A torn file with a garbage length at the tail recovers the definitions and no messages, instead of reading out of bounds
+    {
+        const int fd = ::open(path,O_RDWR);
+        assert(fd >= 0);
+        const auto size = static_cast<std::size_t>(::lseek(fd,0,SEEK_END));
+        void* memory = ::mmap(nullptr,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+        ::close(fd);
+        assert(memory != MAP_FAILED);
+        const auto ring = binlog::Ring::attach(memory,size);
+        const auto& state = ring.state();
+        const std::uint32_t garbage = 0x7FFFFFF0;
+        std::memcpy(static_cast<char*>(memory)+size-state.capacity+state.tail.load()%state.capacity,&garbage,4);
+        ::munmap(memory,size);
+    }
+    const auto torn = binlog::recover(path);
+    std::size_t torn_messages = 0;
+    [[maybe_unused]] const bool decoded_torn = binlog::decode(torn.data(),torn.size(),[&](binlog::WallClock, util::string_view, int, const std::string&) {
+        ++torn_messages;
+    });
+    assert(decoded_torn && torn_messages == 0 && torn.size() > 0);
+    ::unlink(path);
+
+    //Delta arguments are back in sync at the first full value in what the ring kept
+    binlog::LocalRing ring(1024);
+    binlog::Writer writer(ring);
+    for(int i = 0; i < 1000; ++i) {
+        CONSTEXPR_FORMAT_BINLOG(writer, "sequence %d", binlog::delta(5000+i));
+    }
+    const auto kept = ring.linearize();
+    std::size_t unknown = 0;
+    messages.clear();
+    [[maybe_unused]] const bool decoded_kept = binlog::decode(kept.data(),kept.size(),[&](binlog::WallClock, util::string_view, int, const std::string& m) {
+        messages.push_back(m);
+        unknown += m == "sequence ?";
+    });
+    assert(decoded_kept);
+    assert(unknown > 0 && unknown < 64 && messages.back() == "sequence 5999");
+    for(std::size_t i = unknown; i < messages.size(); ++i) {
+        assert(messages[i] == "sequence " + std::to_string(5999-(messages.size()-1-i)));
+    }
+}
+
+void test_memory() {
+    using namespace constexpr_format;
+    memory::Arena arena(1 << 20, {memory::HugePages::reserved,true});
+    assert(arena.capacity() >= (1 << 20));
+    [[maybe_unused]] auto* a = static_cast<char*>(arena.allocate(3));
+    [[maybe_unused]] auto* b = static_cast<std::uint64_t*>(arena.allocate(sizeof(std::uint64_t),alignof(std::uint64_t)));
+    assert(a && b && reinterpret_cast<std::uintptr_t>(b) % alignof(std::uint64_t) == 0 && arena.size() == 16);
+    assert(arena.allocate(arena.capacity()) == nullptr);
+
+    binlog::LocalRing ring(4096);
+    assert(ring);
+    binlog::Writer writer(ring);
+    CONSTEXPR_FORMAT_BINLOG(writer, "local %d", 1);
+    CONSTEXPR_FORMAT_BINLOG(writer, "local %s", std::string(8192,'x'));
+    CONSTEXPR_FORMAT_BINLOG(writer, "local %d", 2);
+    assert(ring.state().oversized == 1);
+    const auto stream = ring.linearize();
+    assert(binlog::decode_to_text(stream.data(),stream.size()).find("local 1\n") != std::string::npos);
+    assert(binlog::decode_to_text(stream.data(),stream.size()).find("local 2\n") != std::string::npos);
+}
+
+void test_binlog_shm() {
+    using namespace constexpr_format;
+    const char* name = "/constexpr_format_test_shm";
+    auto rings = binlog::SharedRings::create(name,4,4096);
+    assert(rings);
+    std::vector<pid_t> children;
+    for(int c = 0; c < 2; ++c) {
+        const pid_t pid = ::fork();
+        if(pid == 0) {
+            auto segment = binlog::SharedRings::open(name);
+            binlog::ProcessRing ring(segment);
+            binlog::Writer writer(ring);
+            for(int i = 0; i < 20; ++i) {
+                CONSTEXPR_FORMAT_BINLOG(writer, "child %d message %d", c, i);
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            std::_Exit(ring ? 0 : 1);
+        }
+        children.push_back(pid);
+    }
+
+    std::FILE* out = std::tmpfile();
+    binlog::Collector collector(rings,out,std::chrono::milliseconds(1));
+    int running = 2;
+    while(running > 0) {
+        collector.drain();
+        int status;
+        while(running > 0 && ::waitpid(-1,&status,WNOHANG) > 0) {
+            assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+            --running;
+        }
+    }
+    collector.drain();
+    collector.flush();
+    assert(collector.lost() == 0);
+
+    std::string stream(static_cast<std::size_t>(std::ftell(out)),'\0');
+    std::rewind(out);
+    [[maybe_unused]] const auto read = std::fread(stream.data(),1,stream.size(),out);
+    assert(read == stream.size());
+    std::fclose(out);
+
+    std::vector<std::int64_t> times;
+    int counts[2] = {};
+    [[maybe_unused]] const bool decoded = binlog::decode(stream.data(),stream.size(),[&](binlog::WallClock t, util::string_view, int, const std::string& m) {
+        times.push_back(t.ns);
+        assert(m == "child 0 message " + std::to_string(counts[0]) || m == "child 1 message " + std::to_string(counts[1]));
+        ++counts[m[6]-'0'];
+    });
+    assert(decoded);
+    assert(counts[0] == 20 && counts[1] == 20);
+    assert(std::is_sorted(times.begin(),times.end()));
+    for(std::uint32_t i = 0; i < rings.slot_count(); ++i) {
+        const auto ring = rings.attach_ring(i);
+        assert(rings.state(i).owner.load() == 0 && rings.state(i).generation.load() % 2 == 0);
+        assert(!ring || ring.state().head.load() == 0);
+    }
+
+    //A collector that fell behind picks the delta arguments up again at their next full value
+    out = std::tmpfile();
+    binlog::Collector behind(rings,out,std::chrono::milliseconds(0));
+    //A writer that died while setting up its slot left the generation odd, freeing the slot makes it even again
+    const pid_t dead = ::fork();
+    if(dead == 0) std::_Exit(0);
+    ::waitpid(dead,nullptr,0);
+    rings.state(0).owner.store(dead);
+    rings.state(0).generation.fetch_add(1);
+    behind.drain();
+    assert(rings.state(0).owner.load() == 0 && rings.state(0).generation.load() % 2 == 0);
+    {
+        binlog::ProcessRing ring(rings);
+        assert(rings.state(0).owner.load() == ::getpid() && rings.state(0).generation.load() % 2 == 0);
+        binlog::Writer writer(ring);
+        for(int i = 0; i < 1000; ++i) {
+            CONSTEXPR_FORMAT_BINLOG(writer, "sequence %d", binlog::delta(5000+i));
+            if(i == 100) behind.drain();
+        }
+    }
+    behind.drain();
+    behind.flush();
+    assert(behind.lost() > 0);
+    stream.assign(static_cast<std::size_t>(std::ftell(out)),'\0');
+    std::rewind(out);
+    [[maybe_unused]] const auto read_behind = std::fread(stream.data(),1,stream.size(),out);
+    assert(read_behind == stream.size());
+    std::fclose(out);
+    std::vector<std::string> messages;
+    [[maybe_unused]] const bool decoded_behind = binlog::decode(stream.data(),stream.size(),[&](binlog::WallClock, util::string_view, int, const std::string& m) {
+        messages.push_back(m);
+    });
+    assert(decoded_behind);
+    assert(messages.size() > 101 && messages[100] == "sequence 5100" && messages.back() == "sequence 5999");
+    for(std::size_t i = 101; i < messages.size(); ++i) {
+        assert(messages[i] == "sequence ?" || messages[i] == "sequence " + std::to_string(5999-(messages.size()-1-i)));
+    }
+    binlog::SharedRings::unlink(name);
+}
+
+void test_log_socket() {
+    using namespace constexpr_format;
+    int fds[2];
+    [[maybe_unused]] int paired = ::socketpair(AF_UNIX,SOCK_DGRAM,0,fds);
+    assert(paired == 0);
+    std::string expected;
+    {
+        log::SocketSink sink(fds[0],64,4);
+        sink.install();
+        for(int i = 0; i < 20; ++i) {
+            CONSTEXPR_FORMAT_LOG(error, "batched message %d", i);
+            expected += "batched message " + std::to_string(i) + "\n";
+        }
+        assert(sink.failed() == 0);
+    }
+    std::string received;
+    int datagrams = 0;
+    char buffer[256];
+    for(ssize_t n; (n = ::recv(fds[1],buffer,sizeof(buffer),MSG_DONTWAIT)) > 0; ++datagrams) {
+        assert(n <= 64);
+        received.append(buffer,n);
+    }
+    assert(received == expected);
+    assert(datagrams > 1 && datagrams < 20);
+
+    ::close(fds[1]);
+
+    //A lone message goes out after max_delay without waiting for the next one
+    paired = ::socketpair(AF_UNIX,SOCK_DGRAM,0,fds);
+    assert(paired == 0);
+    {
+        log::SocketSink sink(fds[0],64,4,std::chrono::milliseconds(1));
+        sink.write(log::Level::error,"late",4);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        [[maybe_unused]] const auto late = ::recv(fds[1],buffer,sizeof(buffer),MSG_DONTWAIT);
+        assert(late == 5 && std::memcmp(buffer,"late\n",5) == 0);
+    }
+    ::close(fds[1]);
+
+    //The sink can be replaced while another thread logs
+    static std::atomic<int> first{0}, second{0};
+    std::atomic<bool> logging{true};
+    log::set_sink([](log::Level, const char*, std::size_t) {++first;});
+    std::thread logger([&]{
+        while(logging) CONSTEXPR_FORMAT_LOG(error, "switching");
+    });
+    while(first == 0) std::this_thread::yield();
+    for(int i = 0; i < 1000; ++i) {
+        log::set_sink([](log::Level, const char*, std::size_t) {++second;});
+        log::set_sink([](log::Level, const char*, std::size_t) {++first;});
+    }
+    logging = false;
+    logger.join();
+    log::set_sink(log::stderr_sink);
+
+    //Through the collector of log_collector.cpp over a stream socket
+    const char* path = "/tmp/constexpr_format_test_collector";
+    const int listener = log::collector_socket(path,SOCK_STREAM);
+    assert(listener >= 0);
+    std::FILE* out = std::tmpfile();
+    std::atomic<bool> stop{false};
+    std::thread collector([&]{log::collect(listener,out,stop);});
+    expected.clear();
+    {
+        log::SocketSink sink(path,SOCK_STREAM);
+        assert(sink);
+        for(int i = 0; i < 20; ++i) {
+            sink.write(log::Level::error,"collected",9);
+            expected += "collected\n";
+        }
+    }
+    while(static_cast<std::size_t>(std::ftell(out)) < expected.size()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    stop = true;
+    collector.join();
+    std::string text(expected.size(),'\0');
+    std::rewind(out);
+    [[maybe_unused]] const auto read = std::fread(text.data(),1,text.size(),out);
+    [[maybe_unused]] const int after = std::fgetc(out);
+    assert(read == text.size() && after == EOF);
+    assert(text == expected);
+    std::fclose(out);
+    ::close(listener);
+    ::unlink(path);
+}
+
+//Stand-in Redis server for one connection on fd: SET, GET and INCRBY over RESP arrays of bulk strings
+void serve_resp(int fd) {
+    std::map<std::string,std::string> store;
+    std::string in;
+    std::size_t pos = 0;
+    const auto line = [&]() -> std::string {
+        for(std::size_t end; (end = in.find("\r\n",pos)) == std::string::npos;) {
+            char buffer[512];
+            const auto n = ::recv(fd,buffer,sizeof(buffer),0);
+            if(n <= 0) throw std::runtime_error("closed");
+            in.append(buffer,n);
+        }
+        const auto end = in.find("\r\n",pos);
+        std::string l = in.substr(pos,end-pos);
+        pos = end+2;
+        return l;
+    };
+    try {
+        for(;;) {
+            const std::string header = line();
+            assert(header[0] == '*');
+            std::vector<std::string> command;
+            for(int i = std::stoi(header.substr(1)); i > 0; --i) {
+                const std::string length = line();
+                assert(length[0] == '$');
+                const auto n = std::stoul(length.substr(1));
+                while(in.size() < pos+n+2) line();
+                command.push_back(in.substr(pos,n));
+                assert(in.compare(pos+n,2,"\r\n") == 0);
+                pos += n+2;
+            }
+            std::string reply;
+            if(command[0] == "SET") {
+                store[command[1]] = command[2];
+                reply = "+OK\r\n";
+            } else if(command[0] == "GET") {
+                const auto& v = store[command[1]];
+                reply = "$"+std::to_string(v.size())+"\r\n"+v+"\r\n";
+            } else if(command[0] == "INCRBY") {
+                auto& v = store[command[1]];
+                v = std::to_string((v.empty() ? 0 : std::stoll(v))+std::stoll(command[2]));
+                reply = ":"+v+"\r\n";
+            } else {
+                reply = "-ERR unknown command\r\n";
+            }
+            ::send(fd,reply.data(),reply.size(),MSG_NOSIGNAL);
+        }
+    } catch(const std::runtime_error&) {}
+    ::close(fd);
+}
+
+void test_resp() {
+    using namespace constexpr_format;
+    using namespace constexpr_format::string_udl;
+    static_assert(resp::wire_format([]{return "SET  user:%d:name %s"_sv;}) == "*3\r\n$3\r\nSET\r\n$%d\r\nuser:%d:name\r\n$%d\r\n%s\r\n");
+    static_assert(resp::wire_format([]{return "PING 100%%"_sv;}) == "*2\r\n$4\r\nPING\r\n$4\r\n100%%\r\n");
+    assert(resp::encode([]{return "PING"_sv;}) == "*1\r\n$4\r\nPING\r\n");
+    assert(resp::encode([]{return "SET k:%d %*d"_sv;},7,4,5) == "*3\r\n$3\r\nSET\r\n$3\r\nk:7\r\n$4\r\n   5\r\n");
+
+    const std::string name = "Ada Lovelace\r\n";
+    char buffer[128];
+    const auto size = resp::encoded_size([]{return "SET user:%d:name %s"_sv;},42,name);
+    [[maybe_unused]] const char* encoded = resp::encode_to(buffer,[]{return "SET user:%d:name %s"_sv;},42,name);
+    assert(encoded == buffer+size);
+
+    //Pipelined against a local stand-in server
+    const int listener = ::socket(AF_INET,SOCK_STREAM,0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    [[maybe_unused]] const int bound = ::bind(listener,reinterpret_cast<sockaddr*>(&address),sizeof(address));
+    [[maybe_unused]] const int listening = ::listen(listener,1);
+    [[maybe_unused]] const int named = ::getsockname(listener,reinterpret_cast<sockaddr*>(&address),&length);
+    assert(bound == 0 && listening == 0 && named == 0);
+    std::thread server([listener]{serve_resp(::accept(listener,nullptr,nullptr));});
+
+    const int fd = ::socket(AF_INET,SOCK_STREAM,0);
+    [[maybe_unused]] const int connected = ::connect(fd,reinterpret_cast<sockaddr*>(&address),sizeof(address));
+    assert(connected == 0);
+    std::string pipeline(buffer,size);
+    resp::append_to(pipeline,[]{return "GET user:%d:name"_sv;},42);
+    resp::append_to(pipeline,[]{return "INCRBY visits:%s %d"_sv;},"2024-01-01"_sv,-3);
+    resp::append_to(pipeline,[]{return "INCRBY visits:%s %d"_sv;},"2024-01-01"_sv,10);
+    [[maybe_unused]] const auto sent = ::send(fd,pipeline.data(),pipeline.size(),0);
+    assert(sent == static_cast<ssize_t>(pipeline.size()));
+    const std::string expected = "+OK\r\n$14\r\nAda Lovelace\r\n\r\n:-3\r\n:7\r\n";
+    std::string replies;
+    while(replies.size() < expected.size()) {
+        const auto n = ::recv(fd,buffer,sizeof(buffer),0);
+        assert(n > 0);
+        replies.append(buffer,n);
+    }
+    assert(replies == expected);
+    ::close(fd);
+    server.join();
+    ::close(listener);
+}
+
+void test_http() {
+    using namespace constexpr_format;
+    using namespace constexpr_format::string_udl;
+    static_assert(http::wire_format([]{return "HTTP/1.1 %d %s\nContent-Type: %s\r\nServer: edge\n\nX-Request-Id: %d\nCache-Control: no-cache\n"_sv;}) ==
+        "HTTP/1.1 %d %H\r\nServer: edge\r\nCache-Control: no-cache\r\nContent-Type: %H\r\nX-Request-Id: %d\r\nContent-Length: %d\r\nDate: %s\r\n\r\n");
+    //Same-name fields stay in declared order around the ones with specs
+    static_assert(http::wire_format([]{return "HTTP/1.1 200 OK\nSet-Cookie: a=%s\nset-cookie: b=1\nServer: edge\nSet-Cookie: c=%d"_sv;}) ==
+        "HTTP/1.1 200 OK\r\nServer: edge\r\nSet-Cookie: a=%H\r\nset-cookie: b=1\r\nSet-Cookie: c=%d\r\nContent-Length: %d\r\nDate: %s\r\n\r\n");
+
+    char date[http::date_size];
+    [[maybe_unused]] const char* date_end = http::detail::write_date(date,784111777);
+    assert(util::string_view(date,date_end-date) == "Sun, 06 Nov 1994 08:49:37 GMT");
+    date_end = http::detail::write_date(date,951782400);
+    assert(util::string_view(date,date_end-date) == "Tue, 29 Feb 2000 00:00:00 GMT");
+    assert(http::date().begin() == http::date().begin());
+
+    const std::string body = "<p>hello</p>";
+    http::Head head;
+    for(int id : {7,12345}) {
+        head.assign([]{return "HTTP/1.1 200 OK\nContent-Type: text/html\nX-Request-Id: %d\nServer: edge"_sv;},body.size(),id);
+        const auto view = head.view();
+        const std::string text(view.begin(),view.size());
+        const std::string expected = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nServer: edge\r\nX-Request-Id: "+std::to_string(id)+
+            "\r\nContent-Length: 12\r\nDate: ";
+        assert(text.compare(0,expected.size(),expected) == 0);
+        assert(text.size() == expected.size()+http::date_size+4 && text.compare(text.size()-8,8," GMT\r\n\r\n") == 0);
+
+        int fds[2];
+        [[maybe_unused]] const int piped = ::pipe(fds);
+        assert(piped == 0);
+        const auto iov = head.with_body(body.data(),body.size());
+        [[maybe_unused]] const auto written = ::writev(fds[1],iov.data(),2);
+        assert(written == static_cast<ssize_t>(text.size()+body.size()));
+        char buffer[256];
+        [[maybe_unused]] const auto read = ::read(fds[0],buffer,sizeof(buffer));
+        assert(read == static_cast<ssize_t>(text.size()+body.size()));
+        assert(std::string(buffer,text.size()+body.size()) == text+body);
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+
+    //A value can't start a header of its own
+    head.assign([]{return "HTTP/1.1 302 Found\nLocation: %s\nX-Id: %.4s"_sv;},0,std::string("/x\r\nSet-Cookie: y"),"ab\ncd");
+    const std::string redirect(head.view().begin(),head.view().size());
+    const std::string location = "HTTP/1.1 302 Found\r\nLocation: /x  Set-Cookie: y\r\nX-Id: ab c\r\nContent-Length: 0\r\n";
+    assert(redirect.compare(0,location.size(),location) == 0);
+}
+
+void test_prometheus() {
+    using namespace constexpr_format;
+    using namespace constexpr_format::string_udl;
+    static_assert(prometheus::header<prometheus::Type::counter>([]{return "http_requests_total"_sv;},[]{return "Requests \\ handled\nso far"_sv;}) ==
+        "# HELP http_requests_total Requests \\\\ handled\\nso far\n# TYPE http_requests_total counter\n");
+    static_assert(prometheus::sample_format<double>([]{return "rpc_seconds{job=\"api\",method=\"%s\",shard=\"%d\"}"_sv;}) ==
+        "rpc_seconds{job=\"api\",method=\"%Q\",shard=\"%d\"} %V\n");
+
+    prometheus::Exposition out;
+    for(int scrape = 0; scrape < 2; ++scrape) {
+        out.clear();
+        out.family<prometheus::Type::counter>([]{return "http_requests_total"_sv;},[]{return "Requests handled."_sv;});
+        out.sample([]{return "http_requests_total{job=\"api\",method=\"%s\",code=\"%d\"}"_sv;},std::uint64_t(1027),"GET",200);
+        out.sample([]{return "http_requests_total{job=\"api\",method=\"%s\",code=\"%d\"}"_sv;},3,std::string("a\"b\\c\nd"),500);
+        out.family<prometheus::Type::gauge>([]{return "temperature_celsius"_sv;},[]{return "Current temperature."_sv;});
+        out.sample([]{return "temperature_celsius"_sv;},21.5);
+        out.sample([]{return "temperature_celsius{sensor=\"%s\"}"_sv;},-0.1,"out"_sv);
+        out.sample([]{return "temperature_celsius{sensor=\"%s\"}"_sv;},std::numeric_limits<double>::quiet_NaN(),"x"_sv);
+        out.sample([]{return "temperature_celsius{sensor=\"%s\"}"_sv;},std::numeric_limits<double>::infinity(),"y"_sv);
+        out.sample([]{return "temperature_celsius{sensor=\"%s\"}"_sv;},-std::numeric_limits<float>::infinity(),"z"_sv);
+        out.sample([]{return "temperature_celsius{sensor=\"%.2s\"}"_sv;},1e21,"\"\"\"");
+    }
+    assert(out.str() ==
+        "# HELP http_requests_total Requests handled.\n"
+        "# TYPE http_requests_total counter\n"
+        "http_requests_total{job=\"api\",method=\"GET\",code=\"200\"} 1027\n"
+        "http_requests_total{job=\"api\",method=\"a\\\"b\\\\c\\nd\",code=\"500\"} 3\n"
+        "# HELP temperature_celsius Current temperature.\n"
+        "# TYPE temperature_celsius gauge\n"
+        "temperature_celsius 21.5\n"
+        "temperature_celsius{sensor=\"out\"} -0.1\n"
+        "temperature_celsius{sensor=\"x\"} NaN\n"
+        "temperature_celsius{sensor=\"y\"} +Inf\n"
+        "temperature_celsius{sensor=\"z\"} -Inf\n"
+        "temperature_celsius{sensor=\"\\\"\"} 1e+21\n");
+}
+
+void test_statsd() {
+    using namespace constexpr_format;
+    using namespace constexpr_format::string_udl;
+    static_assert(statsd::line_format<statsd::Type::timer>([]{return "api.%s.latency|#env:prod,route:%s"_sv;}) == "api.%s.latency:%s|ms|#env:prod,route:%s");
+    assert(statsd::to_string<statsd::Type::counter>([]{return "api.requests"_sv;},1) == "api.requests:1|c");
+    assert(statsd::to_string<statsd::Type::gauge>([]{return "queue.%d.depth|#env:prod"_sv;},-42,7) == "queue.7.depth:-42|g|#env:prod");
+    assert(statsd::to_string<statsd::Type::distribution>([]{return "api.%s.latency|#route:%s"_sv;},0.25,"users","/v1/users"_sv) ==
+        "api.users.latency:0.25|d|#route:/v1/users");
+
+    const int listener = ::socket(AF_INET,SOCK_DGRAM,0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    [[maybe_unused]] const int bound = ::bind(listener,reinterpret_cast<sockaddr*>(&address),sizeof(address));
+    [[maybe_unused]] const int named = ::getsockname(listener,reinterpret_cast<sockaddr*>(&address),&length);
+    assert(bound == 0 && named == 0);
+
+    std::string expected;
+    [[maybe_unused]] std::uint64_t sent = 0;
+    {
+        statsd::Batcher batch(statsd::Batcher::connect("127.0.0.1",ntohs(address.sin_port)),64);
+        assert(batch);
+        for(int i = 0; i < 20; ++i) {
+            batch.add<statsd::Type::timer>([]{return "db.query|#table:%s"_sv;},i*1.5,i%2 ? "users" : "orders");
+            expected += "db.query:"+std::string(i*1.5 == static_cast<int>(i*1.5) ? std::to_string(i*3/2) : std::to_string(i*3/2)+".5")+
+                "|ms|#table:"+(i%2 ? "users" : "orders")+"\n";
+        }
+        batch.add<statsd::Type::set>([]{return "users.unique|#note:%s"_sv;},12345,std::string(100,'x'));
+        expected += "users.unique:12345|s|#note:"+std::string(100,'x')+"\n";
+        batch.flush();
+        sent = batch.sent();
+        assert(batch.failed() == 0);
+    }
+    std::string received;
+    std::uint64_t datagrams = 0;
+    char buffer[256];
+    for(ssize_t n; (n = ::recv(listener,buffer,sizeof(buffer),MSG_DONTWAIT)) > 0; ++datagrams) {
+        assert(n <= 64 || std::string(buffer,n).find('\n') == std::string::npos);
+        received.append(buffer,n);
+        received += '\n';
+    }
+    assert(received == expected);
+    assert(datagrams == sent && datagrams > 2 && datagrams < 21);
+    ::close(listener);
+}
+
+void test_log_rotate() {
+    using namespace constexpr_format;
+    const std::string base = "/tmp/constexpr_format_test_rotate";
+    std::string written;
+    {
+        log::RotatingFileSink sink(base,256,100);
+        assert(sink);
+        sink.install();
+        std::vector<std::thread> threads;
+        for(int t = 0; t < 4; ++t) {
+            threads.emplace_back([t] {
+                for(int i = 0; i < 50; ++i) {
+                    CONSTEXPR_FORMAT_LOG(error, "thread %d line %d", t, i);
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+            });
+        }
+        for(auto& thread : threads) thread.join();
+        assert(sink.failed() == 0 && sink.file_number() > 2);
+    }
+
+    int lines = 0;
+    for(int number = 1;; ++number) {
+        const auto path = base + "." + std::to_string(number);
+        std::FILE* f = std::fopen(path.c_str(),"rb");
+        if(!f) break;
+        char line[64];
+        while(std::fgets(line,sizeof(line),f)) {
+            assert(std::strncmp(line,"thread ",7) == 0);
+            ++lines;
+        }
+        std::fclose(f);
+        ::unlink(path.c_str());
+    }
+    assert(lines == 200);
+}
+
+int main() {
+    test_string_types();
+    test_options();
+    test_small_integers();
+    test_ranged();
+    test_fixed_float();
+    test_decimal();
+    test_units();
+    test_shortest_batch();
+    test_lazy();
+    test_log_levels();
+    test_log_socket();
+    test_log_rotate();
+    test_resp();
+    test_http();
+    test_prometheus();
+    test_statsd();
+    test_binlog();
+    test_binlog_ring();
+    test_memory();
+    test_binlog_shm();
+}